@@ -7,6 +7,11 @@
 
 export module sequence;
 export import :traits;
+export import :allocator;
+export import :statistics;
+export import :flat;
+export import :queue;
+export import :mapped;
 import :utilities;
 import :storage;
 import :fixed;
@@ -17,35 +22,56 @@ import <assert.h>;
 
 
 // ==============================================================================================================
-// sequence - This is the main class template.
+// sequence - This is the main class template. The allocator is used for all dynamically allocated capacity.
+// The capacity_profile base tracks the high-water size for LEARNED growth (and is empty otherwise).
 
-export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>()>
-class sequence : public sequence_storage<TRAITS.storage, T, TRAITS>
+export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>(), typename ALLOC = std::allocator<T>>
+class sequence : private capacity_profile<T, TRAITS>, public sequence_storage<TRAITS.storage, T, TRAITS, ALLOC>
 {
-	using inherited = sequence_storage<TRAITS.storage, T, TRAITS>;
+	using inherited = sequence_storage<TRAITS.storage, T, TRAITS, ALLOC>;
+	using profile = capacity_profile<T, TRAITS>;
 	using inherited::data_begin;
 	using inherited::data_end;
 	using inherited::reallocate;
 	using inherited::add_at;
+	using inherited::add_range_at;
 	using inherited::add_front;
 	using inherited::add_back;
 	using inherited::add;
 
+	// SEGMENTED storage holds the elements in chunks, incremental reallocation (migrating) holds them in two
+	// capacities while they are moved, and CIRCULAR location wraps them, so their iterators are not pointers. The
+	// first two grow the capacity as the elements are added (storage_grows), so the sequence does not grow it first.
+	static constexpr bool segmented = TRAITS.storage == sequence_storage_lits::SEGMENTED;
+	static constexpr bool migrating = TRAITS.migration_step != 0;
+	static constexpr bool storage_grows = segmented || migrating;
+	static constexpr bool contiguous_iterators = !storage_grows && TRAITS.location != sequence_location_lits::CIRCULAR;
+
+	// DEFERRED discard queues discarded elements for reclaim (a destructor loop is all it saves).
+	static constexpr bool deferred = TRAITS.discard == sequence_discard_lits::DEFERRED && !std::is_trivially_destructible_v<T>;
+
 public:
 
 	using value_type = T;
+	using allocator_type = ALLOC;
 	using reference = value_type&;
 	using const_reference = const value_type&;
-	using iterator = value_type*;
-	using const_iterator = const value_type*;
+	using iterator = std::conditional_t<segmented, segmented_iterator<value_type, TRAITS.capacity>,
+					 std::conditional_t<migrating, migrating_iterator<value_type>,
+					 std::conditional_t<TRAITS.location == sequence_location_lits::CIRCULAR,
+										circular_iterator<value_type>, value_type*>>>;
+	using const_iterator = std::conditional_t<segmented, segmented_iterator<const value_type, TRAITS.capacity>,
+						   std::conditional_t<migrating, migrating_iterator<const value_type>,
+						   std::conditional_t<TRAITS.location == sequence_location_lits::CIRCULAR,
+											  circular_iterator<const value_type>, const value_type*>>>;
 	using reverse_iterator = std::reverse_iterator<iterator>;
 	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+	using inherited::get_allocator;
 	using inherited::size;
 	using inherited::capacity;
 	using inherited::capacity_begin;
 	using inherited::capacity_end;
-	using inherited::erase;
 
 	using traits_type = decltype(TRAITS);
 	static constexpr traits_type traits = TRAITS;
@@ -59,73 +85,180 @@ public:
 				  "Linear capacity growth must be greater than 0.");
 	static_assert(traits.factor > 1.0f,
 				  "Exponential capacity growth must be greater than 1.0.");
+	static_assert(std::has_single_bit(traits.alignment) || traits.alignment == 0,
+				  "Alignment must be 0 or a power of 2.");
+	static_assert(traits.growth != sequence_growth_lits::CUSTOM || traits.growth_function,
+				  "Custom capacity growth requires a growth function.");
+	static_assert(traits.recenter_fill >= 0.0f && traits.recenter_fill <= 1.0f,
+				  "Recenter fill must be between 0.0 and 1.0.");
+	static_assert(traits.shrink_fill >= 0.0f && traits.shrink_fill < 0.5f,
+				  "Shrink fill must be at least 0.0 and less than 0.5.");
+	static_assert(traits.shrink_fill == 0.0f ||
+				  (traits.storage != sequence_storage_lits::STATIC && traits.storage != sequence_storage_lits::FIXED),
+				  "Shrink fill requires storage whose capacity can change.");
+	static_assert(traits.front_bias >= 0.0f && traits.front_bias <= 1.0f,
+				  "Front bias must be between 0.0 and 1.0.");
+	static_assert(traits.learned_percentile >= 0.0f && traits.learned_percentile <= 1.0f,
+				  "Learned percentile must be between 0.0 and 1.0.");
+
+	// The allocator must allocate elements, and its pointers must be plain pointers since
+	// the iterators are plain pointers (or hold them, for CIRCULAR location).
+	static_assert(std::same_as<typename allocator_type::value_type, value_type>,
+				  "Allocator value type must match the element type.");
+	static_assert(std::same_as<typename std::allocator_traits<allocator_type>::pointer, value_type*>,
+				  "Allocators with fancy pointers are not supported.");
 
 	// Maintaining elements in the middle of the capacity is more or less useless without the ability to shift.
 	static_assert(traits.location != sequence_location_lits::MIDDLE || std::move_constructible<T>,
 				  "Middle element location requires move-constructible types.");
 
+	// A ring buffer needs a capacity which never moves or grows.
+	static_assert(traits.location != sequence_location_lits::CIRCULAR ||
+				  traits.storage == sequence_storage_lits::STATIC || traits.storage == sequence_storage_lits::FIXED,
+				  "Circular element location requires STATIC or FIXED storage.");
+
 	// A fixed capacity of any kind requires that the size type can represent a count up to the fixed capacity size.
-	static_assert(traits.storage == sequence_storage_lits::VARIABLE ||
+	static_assert(traits.storage == sequence_storage_lits::VARIABLE || traits.storage == sequence_storage_lits::RESERVED ||
+				  traits.storage == sequence_storage_lits::SEGMENTED ||
 				  traits.capacity <= std::numeric_limits<size_type>::max(),
 				  "Size type is insufficient to hold requested capacity.");
 
+	// Incremental reallocation moves the elements of VARIABLE storage, which it keeps at the front, and grows as
+	// specified by the traits alone.
+	static_assert(traits.migration_step == 0 ||
+				  (traits.storage == sequence_storage_lits::VARIABLE && traits.location == sequence_location_lits::FRONT &&
+				   traits.growth != sequence_growth_lits::LEARNED),
+				  "Incremental reallocation requires VARIABLE storage, FRONT location and growth other than LEARNED.");
+
+	// STATIC storage elements cannot change hands, so DEFERRED discard would only move them.
+	static_assert(traits.discard != sequence_discard_lits::DEFERRED || traits.storage != sequence_storage_lits::STATIC,
+				  "Deferred discard requires dynamically allocated storage.");
+
+	// Only FIXED storage blocks are all the same size.
+	static_assert(traits.block_cache == 0 || traits.storage == sequence_storage_lits::FIXED,
+				  "A block cache requires FIXED storage.");
+
+	// Reserved storage must reserve room for at least the initial capacity.
+	static_assert(traits.storage != sequence_storage_lits::RESERVED ||
+				  (traits.reservation > 0 && traits.reservation >= traits.capacity),
+				  "Reserved storage requires a reservation of at least the capacity.");
+
 	sequence() = default;
+	constexpr explicit sequence(const allocator_type& alloc) : inherited(alloc) {}
 	sequence(const sequence&) = default;
 	sequence(sequence&&) = default;
-	sequence(std::initializer_list<value_type> il) : inherited(il) {}
+	constexpr sequence(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il, alloc) {}
+
+	constexpr ~sequence()
+	{
+		profile::record_size(size());
+		if constexpr (deferred)
+			discard();
+	}
 
 	sequence& operator=(const sequence&) = default;
-	sequence& operator=(sequence&&) = default;
+	sequence& operator=(sequence&&) requires (!deferred) = default;
+	constexpr sequence& operator=(sequence&& rhs) requires (deferred)
+	{
+		if (this != &rhs)
+			discard();
+		profile::operator=(std::move(rhs));
+		inherited::operator=(std::move(rhs));
+		return *this;
+	}
+
+	constexpr iterator				begin() { return data_begin(); }
+	constexpr const_iterator			begin() const { return data_begin(); }
+	constexpr iterator				end() { return data_end(); }
+	constexpr const_iterator			end() const { return data_end(); }
+	constexpr reverse_iterator		rbegin() { return reverse_iterator(data_end()); }
+	constexpr const_reverse_iterator	rbegin() const { return const_reverse_iterator(data_end()); }
+	constexpr reverse_iterator		rend() { return reverse_iterator(data_begin()); }
+	constexpr const_reverse_iterator	rend() const { return const_reverse_iterator(data_begin()); }
 
-	iterator				begin() { return data_begin(); }
-	const_iterator			begin() const { return data_begin(); }
-	iterator				end() { return data_end(); }
-	const_iterator			end() const { return data_end(); }
-	reverse_iterator		rbegin() { return reverse_iterator(data_end()); }
-	const_reverse_iterator	rbegin() const { return const_reverse_iterator(data_end()); }
-	reverse_iterator		rend() { return reverse_iterator(data_begin()); }
-	const_reverse_iterator	rend() const { return const_reverse_iterator(data_begin()); }
+	constexpr const_iterator			cbegin() const { return data_begin(); }
+	constexpr const_iterator			cend() const { return data_end(); }
+	constexpr const_reverse_iterator	crbegin() const { return const_reverse_iterator(data_end()); }
+	constexpr const_reverse_iterator	crend() const { return const_reverse_iterator(data_begin()); }
 
-	const_iterator			cbegin() const { return data_begin(); }
-	const_iterator			cend() const { return data_end(); }
-	const_reverse_iterator	crbegin() const { return const_reverse_iterator(data_end()); }
-	const_reverse_iterator	crend() const { return const_reverse_iterator(data_begin()); }
+	constexpr value_type*				data() requires (contiguous_iterators) { return data_begin(); }
+	constexpr const value_type*		data() const requires (contiguous_iterators) { return data_begin(); }
 
-	value_type*				data() { return data_begin(); }
-	const value_type*		data() const { return data_begin(); }
+	// The segments function returns the elements as two contiguous parts. The second part is empty unless
+	// the elements of a CIRCULAR location sequence wrap around the end of the capacity. The linearize function
+	// moves the elements of a CIRCULAR location sequence into one part at the start of the capacity (if needed)
+	// and returns a pointer to them. For the other locations the elements are always in one part. (With
+	// incremental reallocation, linearize finishes any migration. SEGMENTED storage holds the elements in chunks,
+	// which the contiguous function below joins instead.)
+
+	constexpr std::pair<std::span<value_type>, std::span<value_type>> segments() requires (!storage_grows)
+	{
+		if constexpr (traits.location == sequence_location_lits::CIRCULAR)
+			return inherited::segments();
+		else
+			return {std::span(data_begin(), size()), {}};
+	}
+	constexpr std::pair<std::span<const value_type>, std::span<const value_type>> segments() const requires (!storage_grows)
+	{
+		if constexpr (traits.location == sequence_location_lits::CIRCULAR)
+			return inherited::segments();
+		else
+			return {std::span(data_begin(), size()), {}};
+	}
+	constexpr value_type* linearize() requires (!segmented)
+	{
+		if constexpr (traits.location == sequence_location_lits::CIRCULAR || migrating)
+			return inherited::linearize();
+		else
+			return data_begin();
+	}
 
-	value_type& front() { return *data_begin(); }
-	value_type& back() { return *(data_end() - 1); }
-	const value_type& front() const { return *data_begin(); }
-	const value_type& back() const { return *(data_end() - 1); }
+	// The contiguous function moves the elements of a SEGMENTED storage sequence into a single block (if they
+	// are not already contiguous) and returns a pointer to them, or nullptr if the sequence is empty. The elements
+	// stay contiguous until a chunk is added at either end. The moved elements keep their order, but references
+	// to them are invalidated.
 
-	value_type& at(size_t index)
+	constexpr value_type* contiguous() requires (segmented)
+	{
+		return inherited::contiguous();
+	}
+
+	constexpr value_type& front() { return *data_begin(); }
+	constexpr value_type& back() { return *(data_end() - 1); }
+	constexpr const value_type& front() const { return *data_begin(); }
+	constexpr const value_type& back() const { return *(data_end() - 1); }
+
+	constexpr value_type& at(size_t index)
 	{
 		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
 		return *(data_begin() + index);
 	}
-	const value_type& at(size_t index) const
+	constexpr const value_type& at(size_t index) const
 	{
 		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
 		return *(data_begin() + index);
 	}
-	value_type& operator[](size_t index) & { return *(data_begin() + index); }
-	const value_type& operator[](size_t index) const && { return *(data_begin() + index); }
+	constexpr value_type& operator[](size_t index) & { return *(data_begin() + index); }
+	constexpr const value_type& operator[](size_t index) const & { return *(data_begin() + index); }
 
-	bool empty() const { return size() == 0; }
+	constexpr bool empty() const { return size() == 0; }
 
-	void reserve(size_t new_capacity)
+	constexpr void reserve(size_t new_capacity)
 	{
 		if (new_capacity > capacity())
 			reallocate(new_capacity);
 	}
-	void shrink_to_fit()
+	constexpr void shrink_to_fit()
 	{
 		if (auto current_size = size(); current_size < capacity())
 			reallocate(current_size);
 	}
+	// The resize function constructs the new elements from 'args' (value initializing them if there are none).
+	// An element argument which refers into the sequence is copied first, since growth may move the elements.
+
 	template<typename... ARGS>
-	void resize(size_t new_size, ARGS&&... args)
+	constexpr void resize(size_t new_size, ARGS&&... args)
 	{
 		auto old_size = size();
 
@@ -133,43 +266,434 @@ public:
 			erase(data_end() - (old_size - new_size), data_end());
 		else if (new_size > old_size)
 		{
+			if constexpr (sizeof...(ARGS) == 1 && (std::same_as<std::remove_cvref_t<ARGS>, value_type> && ...))
+			{
+				if ((refers_into(&args) || ...))
+				{
+					value_type copy(args...);
+					resize(new_size, std::as_const(copy));
+					return;
+				}
+			}
 			if (new_size > capacity())
 				reallocate(std::max(new_size, traits.capacity));
 			add(new_size - old_size, std::forward<ARGS>(args)...);
 		}
 	}
 
+	// The resize_for_overwrite function default initializes the new elements, so trivial elements are left
+	// uninitialized. This avoids zeroing a buffer which is about to be filled (for instance by I/O).
+
+	constexpr void resize_for_overwrite(size_t new_size)
+	{
+		resize(new_size, default_construct);
+	}
+
+	// If the capacity must grow, the emplace functions first construct a temporary from arguments which may
+	// refer to the elements (see constructible_in_gap), since the reallocation would invalidate them. (Storage
+	// which grows itself handles such arguments itself.)
+
 	template< class... ARGS >
-	iterator emplace(const_iterator cpos, ARGS&&... args)
+	constexpr iterator emplace(const_iterator cpos, ARGS&&... args)
 	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
+		if (auto old_capacity = capacity(); !storage_grows && size() == old_capacity)
 		{
+			if (!constructible_in_gap(occupied_begin(), occupied_end(), args...))
+				return emplace(cpos, value_type(std::forward<ARGS>(args)...));
 			size_t index = cpos - data_begin();
-			reallocate(traits.grow(old_capacity));
+			reallocate(grow(old_capacity));
 			cpos = data_begin() + index;
 		}
-		return add_at(const_cast<iterator>(cpos), std::forward<ARGS>(args)...);
+		return add_at(data_begin() + (cpos - data_begin()), std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void emplace_front(ARGS&&... args)
+	constexpr void emplace_front(ARGS&&... args)
 	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
-			reallocate(traits.grow(old_capacity));
+		if (auto old_capacity = capacity(); !storage_grows && size() == old_capacity)
+		{
+			if (!constructible_in_gap(occupied_begin(), occupied_end(), args...))
+				return emplace_front(value_type(std::forward<ARGS>(args)...));
+			reallocate(grow(old_capacity));
+		}
 		add_front(std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void emplace_back(ARGS&&... args)
+	constexpr void emplace_back(ARGS&&... args)
 	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
-			reallocate(traits.grow(old_capacity));
+		if (auto old_capacity = capacity(); !storage_grows && size() == old_capacity)
+		{
+			if (!constructible_in_gap(occupied_begin(), occupied_end(), args...))
+				return emplace_back(value_type(std::forward<ARGS>(args)...));
+			reallocate(grow(old_capacity));
+		}
 		add_back(std::forward<ARGS>(args)...);
 	}
 
-	iterator insert(const_iterator cpos, const_reference e) { return emplace(cpos, e); }
-	void push_front(const_reference e) { emplace_front(e); }
-	void push_back(const_reference e) { emplace_back(e); }
+	// The removal functions note the size first, for LEARNED growth, and then shrink the capacity if it has
+	// become sparse (see shrink_fill).
+
+	constexpr void clear()
+	{
+		profile::note_size(size());
+		if constexpr (deferred)
+			discard();
+		inherited::clear();
+		shrink_sparse();
+	}
+	constexpr void erase(iterator erase_begin, iterator erase_end)
+	{
+		profile::note_size(size());
+		inherited::erase(erase_begin, erase_end);
+		shrink_sparse();
+	}
+	constexpr void erase(iterator element)
+	{
+		profile::note_size(size());
+		inherited::erase(element);
+		shrink_sparse();
+	}
+	constexpr void pop_front()
+	{
+		profile::note_size(size());
+		inherited::pop_front();
+		shrink_sparse();
+	}
+	constexpr void pop_back()
+	{
+		profile::note_size(size());
+		inherited::pop_back();
+		shrink_sparse();
+	}
+
+	// The adopt function replaces the elements and capacity of a VARIABLE storage sequence with a block allocated
+	// by its allocator (which the sequence will deallocate). The elements must be where the location keeps them
+	// (at the front for FRONT location, at the back for BACK location, anywhere for MIDDLE location). The release
+	// function hands the capacity and elements to the caller, who must destroy them and deallocate the block
+	// with the allocator, and leaves the sequence empty with no capacity. Neither copies the elements.
+
+	constexpr void adopt(const sequence_block<value_type>& block) requires (traits.storage == sequence_storage_lits::VARIABLE)
+	{
+		profile::note_size(size());
+		inherited::adopt(block);
+	}
+	constexpr sequence_block<value_type> release() requires (traits.storage == sequence_storage_lits::VARIABLE)
+	{
+		profile::note_size(size());
+		return inherited::release();
+	}
+
+	constexpr iterator insert(const_iterator cpos, const_reference e) { return emplace(cpos, e); }
+	constexpr void push_front(const_reference e) { emplace_front(e); }
+	constexpr void push_back(const_reference e) { emplace_back(e); }
+
+	// The bulk insertion functions grow the capacity at most once and open a single gap for the new
+	// elements (at the nearer end for MIDDLE location). Forward ranges are constructed directly in
+	// place. Single pass input ranges are inserted one element at a time.
+
+	constexpr iterator insert(const_iterator cpos, size_t count, const_reference e)
+	{
+		if (refers_into(&e))
+		{
+			value_type copy(e);
+			return insert_n(cpos, repeat_iterator(copy), count);
+		}
+		return insert_n(cpos, repeat_iterator(e), count);
+	}
+	template<std::input_iterator ITER>
+	constexpr iterator insert(const_iterator cpos, ITER first, ITER last)
+	{
+		if constexpr (std::forward_iterator<ITER>)
+			return insert_n(cpos, first, std::distance(first, last));
+		else
+		{
+			size_t index = cpos - data_begin();
+			for (auto pos = index; first != last; ++first)
+				emplace(data_begin() + pos++, *first);
+			return data_begin() + index;
+		}
+	}
+	constexpr iterator insert(const_iterator cpos, std::initializer_list<value_type> il)
+	{
+		return insert_n(cpos, il.begin(), il.size());
+	}
+	template<std::ranges::input_range RANGE>
+	constexpr iterator insert_range(const_iterator cpos, RANGE&& range)
+	{
+		if constexpr (std::ranges::forward_range<RANGE>)
+			return insert_n(cpos, std::ranges::begin(range), std::ranges::distance(range));
+		else
+		{
+			size_t index = cpos - data_begin();
+			if constexpr (std::ranges::sized_range<RANGE>)
+				make_room(std::ranges::size(range));
+			auto pos = index;
+			for (auto&& e : range)
+				emplace(data_begin() + pos++, std::forward<decltype(e)>(e));
+			return data_begin() + index;
+		}
+	}
+	template<std::ranges::input_range RANGE>
+	constexpr void append_range(RANGE&& range)
+	{
+		insert_range(data_end(), std::forward<RANGE>(range));
+	}
+	template<std::ranges::input_range RANGE>
+	constexpr void prepend_range(RANGE&& range)
+	{
+		insert_range(data_begin(), std::forward<RANGE>(range));
+	}
+
+	constexpr void assign(size_t count, const_reference e)
+	{
+		if (refers_into(&e))
+		{
+			value_type copy(e);
+			this->clear();
+			insert_n(data_begin(), repeat_iterator(copy), count);
+		}
+		else
+		{
+			this->clear();
+			insert_n(data_begin(), repeat_iterator(e), count);
+		}
+	}
+	template<std::input_iterator ITER>
+	constexpr void assign(ITER first, ITER last)
+	{
+		this->clear();
+		insert(data_begin(), first, last);
+	}
+	constexpr void assign(std::initializer_list<value_type> il)
+	{
+		this->clear();
+		insert_n(data_begin(), il.begin(), il.size());
+	}
+	template<std::ranges::input_range RANGE>
+	constexpr void assign_range(RANGE&& range)
+	{
+		this->clear();
+		insert_range(data_begin(), std::forward<RANGE>(range));
+	}
+
+	// The erase and erase_if functions erase the elements which equal 'value' or satisfy the predicate, and the
+	// unique function erases all but the first of each run of equivalent elements. They return the number erased.
+	// They may be given an execution policy (such as std::execution::par_unseq) for the underlying algorithms,
+	// which work on contiguous elements. The remaining elements on one side of the first erased element (toward the
+	// front) or of the last (toward the back) are compacted, and only the run on the other side is not moved. For
+	// MIDDLE and CIRCULAR location the side which leaves the longer run unmoved is compacted (the back for BACK
+	// location, the front otherwise).
+
+	template<typename U>
+	friend constexpr size_type erase(sequence& s, const U& value)
+	{
+		return s.erase_matching([&](const value_type& e){ return e == value; });
+	}
+	template<execution_policy POLICY, typename U>
+	friend size_type erase(POLICY&& policy, sequence& s, const U& value)
+	{
+		return s.erase_matching([&](const value_type& e){ return e == value; }, policy);
+	}
+	template<typename PRED>
+	friend constexpr size_type erase_if(sequence& s, PRED pred)
+	{
+		return s.erase_matching(pred);
+	}
+	template<execution_policy POLICY, typename PRED>
+	friend size_type erase_if(POLICY&& policy, sequence& s, PRED pred)
+	{
+		return s.erase_matching(pred, policy);
+	}
+
+	template<typename PRED = std::equal_to<>>
+	constexpr size_type unique(PRED pred = PRED())
+	{
+		auto new_end = std::unique(begin(), end(), pred);
+		size_type count = end() - new_end;
+		erase(new_end, end());
+		return count;
+	}
+	template<execution_policy POLICY, typename PRED = std::equal_to<>>
+	size_type unique(POLICY&& policy, PRED pred = PRED())
+	{
+		auto new_end = std::unique(policy, begin(), end(), pred);
+		size_type count = end() - new_end;
+		erase(new_end, end());
+		return count;
+	}
+
+	// The statistics functions return a snapshot of the statistics for this sequence type (all sequences with the
+	// same element type and traits) and zero them. They are available only if 'statistics' is set in the traits.
+
+	static sequence_statistics statistics() requires (traits.statistics)
+	{
+		return statistics_snapshot<T, TRAITS>();
+	}
+	static void reset_statistics() requires (traits.statistics)
+	{
+		::reset_statistics<T, TRAITS>();
+	}
+
+	// The reclaim function destroys the elements discarded by sequences of this type (all sequences with the same
+	// element type, traits and allocator) and returns the number of discards. It is available only for DEFERRED
+	// discard, and is meant to be called (from time to time) by a background thread.
+
+	static size_t reclaim() requires (traits.discard == sequence_discard_lits::DEFERRED)
+	{
+		if constexpr (deferred)
+			return sequence_reclaimer<inherited>::reclaim();
+		else
+			return 0;
+	}
+
+	// The learned_capacity function returns the capacity of the first dynamic allocation for LEARNED growth.
+
+	constexpr static size_t learned_capacity() requires (traits.growth == sequence_growth_lits::LEARNED)
+	{
+		return profile::learned_capacity();
+	}
 
 private:
 
+	// The grow function returns the capacity to grow to from 'cap' (see sequence_grow).
+
+	constexpr size_t grow(size_t cap) const
+	{
+		return sequence_grow<T, traits>(cap, this->is_dynamic());
+	}
+
+	// The occupied functions return the range of addresses which may hold elements, for the checks for
+	// arguments which refer to the elements. For CIRCULAR location this is the whole capacity. (Storage which
+	// grows itself does not use the range, since its elements are not one range.) The refers_into function returns
+	// true if an element argument is one of the elements, for the functions which copy such an argument first.
+
+	constexpr const value_type* occupied_begin() const
+	{
+		if constexpr (storage_grows)
+			return nullptr;
+		else if constexpr (traits.location == sequence_location_lits::CIRCULAR)
+			return capacity_begin();
+		else
+			return data_begin();
+	}
+	constexpr const value_type* occupied_end() const
+	{
+		if constexpr (storage_grows)
+			return nullptr;
+		else if constexpr (traits.location == sequence_location_lits::CIRCULAR)
+			return capacity_end();
+		else
+			return data_end();
+	}
+	constexpr bool refers_into(const value_type* p) const
+	{
+		if constexpr (storage_grows)
+			return inherited::holds(p);
+		else
+			return points_into(p, occupied_begin(), occupied_end());
+	}
+
+	// The shrink_sparse function reduces the capacity to twice the size (but not below the initial capacity) if the
+	// sequence is filled less than 'shrink_fill' of it. Since this follows a removal, which does not otherwise
+	// allocate, a failure to allocate the smaller capacity is ignored.
+
+	constexpr void shrink_sparse()
+	{
+		if constexpr (traits.shrink_fill > 0.0f)
+		{
+			auto old_capacity = capacity();
+			auto new_capacity = std::max(2 * size(), traits.capacity);
+			if (size() < traits.shrink_fill * old_capacity && new_capacity < old_capacity)
+			{
+				try
+				{
+					reallocate(new_capacity);
+				}
+				catch (const std::bad_alloc&)
+				{
+				}
+			}
+		}
+	}
+
+	// The discard function queues the elements (and their capacity) for reclaim, for DEFERRED discard. In constant
+	// evaluation (or if they cannot be queued) they are left to be destroyed as usual.
+
+	constexpr void discard()
+	{
+		if !consteval
+		{
+			if (size())
+				sequence_reclaimer<inherited>::defer(*this);
+		}
+	}
+
+	// The erase_matching function erases the elements which satisfy the predicate. The elements from the first of
+	// them to the end are compacted toward the front, or (by removing through reverse iterators) those from the
+	// last of them to the beginning toward the back, and then the vacated elements are erased from that end.
+
+	template<typename PRED, typename... POLICY>
+	constexpr size_type erase_matching(PRED pred, POLICY&... policy)
+	{
+		auto first = std::find_if(policy..., begin(), end(), pred);
+		if (first == end())
+			return 0;
+		auto last = std::find_if(policy..., rbegin(), std::make_reverse_iterator(first + 1), pred).base();
+
+		bool toward_back = traits.location == sequence_location_lits::BACK;
+		if constexpr (traits.location == sequence_location_lits::MIDDLE || traits.location == sequence_location_lits::CIRCULAR)
+			toward_back = first - begin() < end() - last;
+
+		size_type count;
+		if (toward_back)
+		{
+			auto new_begin = std::remove_if(policy..., std::make_reverse_iterator(last), rend(), pred).base();
+			count = new_begin - begin();
+			erase(begin(), new_begin);
+		}
+		else
+		{
+			auto new_end = std::remove_if(policy..., first, end(), pred);
+			count = end() - new_end;
+			erase(new_end, end());
+		}
+		return count;
+	}
+
+	// The make_room function ensures that there is capacity for 'count' more elements. If the capacity
+	// must grow, it grows once to the larger of the required capacity and the normal growth step. (Storage
+	// which grows itself does so as the elements are added.)
+
+	constexpr void make_room(size_t count)
+	{
+		if (auto required = size() + count; !storage_grows && required > capacity())
+			reallocate(std::max(required, grow(capacity())));
+	}
+
+	// The insert_n function inserts 'count' elements copied from the forward iterator 'first' at 'cpos'.
+
+	template<typename ITER>
+	constexpr iterator insert_n(const_iterator cpos, ITER first, size_t count)
+	{
+		size_t index = cpos - data_begin();
+		if (count == 0)
+			return data_begin() + index;
+		make_room(count);
+		return add_range_at(data_begin() + index, first, count);
+	}
+
 	constexpr static auto OUT_OF_RANGE_ERROR = "invalid sequence index {}";
 };
+
+// ==============================================================================================================
+// sequence_flat_set, sequence_flat_map - Sorted associative containers which keep their elements in a sequence (see
+// the flat partition). The default traits use MIDDLE location, so that insertion and erasure shift the nearer end.
+
+export constexpr sequence_traits<size_t> sequence_flat_traits{.location = sequence_location_lits::MIDDLE};
+
+export template<typename KEY, typename COMPARE = std::less<KEY>, sequence_traits TRAITS = sequence_flat_traits,
+				typename ALLOC = std::allocator<KEY>>
+using sequence_flat_set = flat_set<sequence<KEY, TRAITS, ALLOC>, COMPARE>;
+
+export template<typename KEY, typename VALUE, typename COMPARE = std::less<KEY>, sequence_traits TRAITS = sequence_flat_traits,
+				typename ALLOC = std::allocator<std::pair<KEY, VALUE>>>
+using sequence_flat_map = flat_map<sequence<std::pair<KEY, VALUE>, TRAITS, ALLOC>, COMPARE>;
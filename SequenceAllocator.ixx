@@ -0,0 +1,304 @@
+export module sequence:allocator;
+import :traits;
+
+import std;
+
+// ==============================================================================================================
+// Allocator hooks. These are optional allocator members which allow VARIABLE storage to grow its capacity
+// without moving every element into a new block. An allocator which provides neither is used in the normal way.
+
+// sequence_expandable_allocator - The allocator provides 'expand(p, n, new_n)', which attempts to extend the block
+// 'p' of 'n' elements in place to 'new_n' elements. It returns false (and leaves the block alone) if it cannot.
+
+export template<typename ALLOC>
+concept sequence_expandable_allocator = requires(ALLOC& alloc, typename ALLOC::value_type* p, size_t n)
+{
+	{ alloc.expand(p, n, n) } -> std::convertible_to<bool>;
+};
+
+// sequence_reallocatable_allocator - The allocator provides 'reallocate(p, n, new_n)', which resizes the block 'p'
+// of 'n' elements to 'new_n' elements (like realloc), moving its bytes if necessary. It returns the (possibly new)
+// block, or throws (leaving the block alone) if it cannot. Since the bytes may be moved, this is used only for
+// trivially relocatable elements.
+
+export template<typename ALLOC>
+concept sequence_reallocatable_allocator = requires(ALLOC& alloc, typename ALLOC::value_type* p, size_t n)
+{
+	{ alloc.reallocate(p, n, n) } -> std::same_as<typename ALLOC::value_type*>;
+};
+
+// sequence_malloc_allocator - An allocator based on malloc/realloc/free. It provides the reallocate hook,
+// so sequences of trivially relocatable elements can often grow in place without copying.
+
+export template<typename T>
+class sequence_malloc_allocator
+{
+	static_assert(alignof(T) <= alignof(std::max_align_t),
+				  "sequence_malloc_allocator does not support over-aligned types.");
+
+public:
+
+	using value_type = T;
+	using is_always_equal = std::true_type;
+
+	sequence_malloc_allocator() = default;
+	template<typename U>
+	sequence_malloc_allocator(const sequence_malloc_allocator<U>&) {}
+
+	value_type* allocate(size_t n)
+	{
+		if (n > std::numeric_limits<size_t>::max() / sizeof(value_type))
+			throw std::bad_array_new_length();
+		if (auto p = std::malloc(n * sizeof(value_type)))
+			return static_cast<value_type*>(p);
+		throw std::bad_alloc();
+	}
+	void deallocate(value_type* p, size_t)
+	{
+		std::free(p);
+	}
+	value_type* reallocate(value_type* p, size_t, size_t new_n)
+	{
+		if (new_n > std::numeric_limits<size_t>::max() / sizeof(value_type))
+			throw std::bad_array_new_length();
+		if (auto new_p = std::realloc(p, new_n * sizeof(value_type)))
+			return static_cast<value_type*>(new_p);
+		throw std::bad_alloc();
+	}
+
+	template<typename U>
+	bool operator==(const sequence_malloc_allocator<U>&) const { return true; }
+};
+
+// sequence_block - A block of capacity which is handed between a VARIABLE sequence and its owner (see adopt and
+// release). The block holds 'capacity' elements and was allocated by the sequence's allocator (so that the sequence
+// can deallocate it). The 'size' elements starting 'front_gap' elements into the block are constructed.
+
+export template<typename T>
+struct sequence_block
+{
+	T* capacity_begin = nullptr;
+	size_t capacity = 0;
+	size_t front_gap = 0;
+	size_t size = 0;
+};
+
+// sequence_allocate - Allocates at least 'n' elements and returns the block and the number of elements it holds.
+// If the allocator provides allocate_at_least (as std::allocator does in C++23), any slack the allocator rounds
+// up to is returned as well so that it can become usable capacity.
+
+template<typename ALLOC>
+constexpr std::pair<typename ALLOC::value_type*, size_t> sequence_allocate(ALLOC& alloc, size_t n)
+{
+	if constexpr (requires { alloc.allocate_at_least(n); })
+	{
+		auto [p, count] = alloc.allocate_at_least(n);
+		return {p, count};
+	}
+	else
+		return {std::allocator_traits<ALLOC>::allocate(alloc, n), n};
+}
+
+// aligned_block - The header stored just before an over-aligned block. It holds the allocation which contains
+// the block, so that the block can be deallocated. (It is copied with memcpy since it may not be aligned.)
+
+template<typename T>
+struct aligned_block
+{
+	T* allocation;
+	size_t count;
+};
+
+// The aligned versions of sequence_allocate and sequence_deallocate over-align the block to ALIGN bytes (see
+// sequence_traits::alignment). If ALIGN is no more than the element alignment, they are the same as allocating
+// and deallocating directly. Otherwise the block is placed within a larger allocation, after its header, so any
+// allocator may be used.
+
+template<size_t ALIGN, typename ALLOC>
+constexpr std::pair<typename ALLOC::value_type*, size_t> sequence_allocate(ALLOC& alloc, size_t n)
+{
+	using value_type = typename ALLOC::value_type;
+	using header = aligned_block<value_type>;
+
+	if constexpr (ALIGN <= alignof(value_type))
+		return sequence_allocate(alloc, n);
+	else
+	{
+		constexpr size_t extra = (sizeof(header) + ALIGN - 1 + sizeof(value_type) - 1) / sizeof(value_type);
+
+		auto [allocation, count] = sequence_allocate(alloc, n + extra);
+		auto address = reinterpret_cast<std::uintptr_t>(allocation) + sizeof(header);
+		auto begin = reinterpret_cast<value_type*>((address + ALIGN - 1) & ~(ALIGN - 1));
+		header block{allocation, count};
+		std::memcpy(reinterpret_cast<char*>(begin) - sizeof(header), &block, sizeof(header));
+		auto end = reinterpret_cast<char*>(allocation + count);
+		return {begin, size_t(end - reinterpret_cast<char*>(begin)) / sizeof(value_type)};
+	}
+}
+
+template<size_t ALIGN, typename ALLOC>
+constexpr void sequence_deallocate(ALLOC& alloc, typename ALLOC::value_type* p, size_t n)
+{
+	using value_type = typename ALLOC::value_type;
+	using header = aligned_block<value_type>;
+
+	if constexpr (ALIGN <= alignof(value_type))
+		std::allocator_traits<ALLOC>::deallocate(alloc, p, n);
+	else
+	{
+		header block;
+		std::memcpy(&block, reinterpret_cast<char*>(p) - sizeof(header), sizeof(header));
+		std::allocator_traits<ALLOC>::deallocate(alloc, block.allocation, block.count);
+	}
+}
+
+// sequence_block_cache - A cache of freed blocks of one type (see sequence_traits::block_cache). Each thread keeps
+// up to LIMIT blocks in a local list, so most allocations and deallocations only push or pop a list. A thread which
+// frees a block when its list is full hands the whole list to a shared list (under a lock), and a thread whose list
+// is empty takes the whole shared list, so blocks freed on one thread return to the threads which allocate them. The
+// shared list holds up to four lists of blocks; beyond that blocks are deallocated. The shared list is never
+// destroyed, so sequences destroyed during static destruction (or in a thread's later thread_local destructors,
+// after its local list) can still free blocks; these are deallocated rather than cached. The link to the next block
+// is copied into the freed block's bytes, which need not be aligned.
+
+template<typename BLOCK, typename ALLOC, size_t LIMIT>
+class sequence_block_cache
+{
+	static_assert(sizeof(BLOCK) >= sizeof(void*), "A cached block must be able to hold a pointer.");
+	static_assert(std::allocator_traits<ALLOC>::is_always_equal::value && std::default_initializable<ALLOC>,
+				  "A block cache requires an always equal, default constructible allocator.");
+
+public:
+
+	// The allocate function returns a cached block, or nullptr if there are none. The deallocate function caches
+	// a block (or deallocates it if the caches are full).
+
+	static BLOCK* allocate()
+	{
+		if (local_list::torn_down)
+			return nullptr;
+		auto& blocks = local_blocks().blocks;
+		if (!blocks.head)
+		{
+			std::scoped_lock lock(shared_blocks().mutex);
+			blocks.splice(shared_blocks().blocks);
+		}
+		return blocks.pop();
+	}
+	static void deallocate(BLOCK* block)
+	{
+		if (local_list::torn_down)
+		{
+			ALLOC alloc;
+			std::allocator_traits<ALLOC>::deallocate(alloc, block, 1);
+			return;
+		}
+		auto& blocks = local_blocks().blocks;
+		if (blocks.count >= LIMIT)
+			hand_over(blocks);
+		blocks.push(block);
+	}
+
+private:
+
+	struct block_list
+	{
+		static std::byte* next(std::byte* block)
+		{
+			std::byte* link;
+			std::memcpy(&link, block, sizeof(link));
+			return link;
+		}
+		void push(BLOCK* block)
+		{
+			auto bytes = reinterpret_cast<std::byte*>(block);
+			std::memcpy(bytes, &head, sizeof(head));
+			if (!head)
+				tail = bytes;
+			head = bytes;
+			++count;
+		}
+		BLOCK* pop()
+		{
+			if (!head)
+				return nullptr;
+			auto block = head;
+			head = next(block);
+			if (!head)
+				tail = nullptr;
+			--count;
+			return reinterpret_cast<BLOCK*>(block);
+		}
+
+		// The splice function moves the blocks of 'other' to the front of this list.
+
+		void splice(block_list& other)
+		{
+			if (!other.head)
+				return;
+			std::memcpy(other.tail, &head, sizeof(head));
+			if (!head)
+				tail = other.tail;
+			head = std::exchange(other.head, nullptr);
+			other.tail = nullptr;
+			count += std::exchange(other.count, 0);
+		}
+		void deallocate()
+		{
+			ALLOC alloc;
+			while (auto block = pop())
+				std::allocator_traits<ALLOC>::deallocate(alloc, block, 1);
+		}
+
+		std::byte* head = nullptr;
+		std::byte* tail = nullptr;
+		size_t count = 0;
+	};
+
+	// The local blocks are handed to the shared list when their thread exits, after which the (trivially
+	// destructible) 'torn_down' flag stops the thread using them. The shared list is leaked.
+
+	struct local_list
+	{
+		~local_list()
+		{
+			hand_over(blocks);
+			torn_down = true;
+		}
+
+		block_list blocks;
+		static inline thread_local bool torn_down = false;
+	};
+	struct shared_list
+	{
+		std::mutex mutex;
+		block_list blocks;
+	};
+
+	static local_list& local_blocks()
+	{
+		thread_local local_list blocks;
+		return blocks;
+	}
+	static shared_list& shared_blocks()
+	{
+		static shared_list& blocks = *new shared_list;
+		return blocks;
+	}
+
+	// The hand_over function moves 'blocks' to the shared list, or deallocates them if it is full.
+
+	static void hand_over(block_list& blocks)
+	{
+		{
+			auto& shared = shared_blocks();
+			std::scoped_lock lock(shared.mutex);
+			if (shared.blocks.count < 4 * LIMIT)
+			{
+				shared.blocks.splice(blocks);
+				return;
+			}
+		}
+		blocks.deallocate();
+	}
+};
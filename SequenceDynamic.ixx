@@ -1,6 +1,9 @@
 export module sequence:dynamic;
 import :traits;
+import :allocator;
+import :statistics;
 import :utilities;
+import :fixed;
 
 import std;
 import <assert.h>;
@@ -8,144 +11,538 @@ import <assert.h>;
 // ==============================================================================================================
 // dynamic_capacity
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_capacity
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_capacity : private ALLOC
 {
 	using value_type = T;
 	using pointer = value_type*;
 	using const_pointer = const value_type*;
+	using allocator_traits = std::allocator_traits<ALLOC>;
+
+	static constexpr bool over_aligned = capacity_alignment<T, TRAITS> > alignof(T);
 
 public:
 
-	dynamic_capacity() : m_capacity_end(nullptr) {}
-	dynamic_capacity(size_t cap) :
-		m_capacity_begin(operator new(sizeof(value_type) * cap))
+	using allocator_type = ALLOC;
+
+	dynamic_capacity() = default;
+	constexpr explicit dynamic_capacity(const allocator_type& alloc) : allocator_type(alloc) {}
+	constexpr dynamic_capacity(size_t cap, const allocator_type& alloc = allocator_type()) : allocator_type(alloc)
 	{
-		m_capacity_end = capacity_begin() + cap;
+		auto [begin, count] = sequence_allocate<capacity_alignment<T, TRAITS>>(allocator(), cap);
+		m_capacity_begin = begin;
+		m_capacity_end = begin + count;
+		count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
 	}
 	dynamic_capacity(const dynamic_capacity&) = delete;
-	dynamic_capacity(dynamic_capacity&& rhs) = default;
+	constexpr dynamic_capacity(dynamic_capacity&& rhs) : allocator_type(std::move(rhs.allocator()))
+	{
+		swap_capacity(rhs);
+	}
+	constexpr ~dynamic_capacity()
+	{
+		deallocate();
+	}
 	dynamic_capacity& operator=(const dynamic_capacity&) = delete;
-	dynamic_capacity& operator=(dynamic_capacity&& rhs) = default;
+	dynamic_capacity& operator=(dynamic_capacity&& rhs) = delete;
+
+	constexpr allocator_type get_allocator() const { return allocator(); }
 
-	size_t capacity() const { return capacity_end() - capacity_begin(); }
-	pointer capacity_begin() { return static_cast<pointer>(m_capacity_begin.get()); }
-	pointer capacity_end() { return m_capacity_end; }
-	const_pointer capacity_begin() const { return static_cast<const_pointer>(m_capacity_begin.get()); }
-	const_pointer capacity_end() const { return m_capacity_end; }
+	constexpr size_t capacity() const { return capacity_end() - capacity_begin(); }
+	constexpr pointer capacity_begin() { return m_capacity_begin; }
+	constexpr pointer capacity_end() { return m_capacity_end; }
+	constexpr const_pointer capacity_begin() const { return m_capacity_begin; }
+	constexpr const_pointer capacity_end() const { return m_capacity_end; }
 
 protected:
 
-	void reallocate(size_t new_cap, size_t offset, pointer data_begin, pointer data_end)
+	constexpr allocator_type& allocator() { return *this; }
+	constexpr const allocator_type& allocator() const { return *this; }
+
+	// The reallocate function moves the elements into a new capacity, placing them according to the location
+	// (or the 'front_gap' function, given the new capacity and the size), and returns the new beginning of the
+	// data. When growing, the allocator hooks (if any) are tried first so that the existing block can be resized
+	// instead (see SequenceAllocator.ixx). An empty range (which may be null, for a capacity being replaced) has
+	// nothing to keep, so a new block is allocated.
+
+	constexpr pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end)
 	{
-		dynamic_capacity<T, TRAITS> new_capacity(new_cap);
-		if (data_begin != data_end)	// This is redundant. Is it actually an optimization?
+		return reallocate(new_cap, data_begin, data_end, [](size_t cap, size_t size){ return aligned_front_gap<T, TRAITS>(cap, size); });
+	}
+	template<std::regular_invocable<size_t, size_t> FUNC>
+	constexpr pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end, FUNC front_gap)
+	{
+		count_event<T, TRAITS>(sequence_event::REALLOCATION);
+		if (m_capacity_begin && data_begin != data_end && new_cap > capacity())
+			if (auto new_data_begin = resize_in_place(new_cap, data_begin, data_end, front_gap(new_cap, data_end - data_begin)))
+				return new_data_begin;
+
+		dynamic_capacity new_capacity(new_cap, allocator());
+		auto new_data_begin = new_capacity.capacity_begin() + front_gap(new_capacity.capacity(), data_end - data_begin);
+		relocate(data_begin, data_end, new_data_begin);
+		this->swap_capacity(new_capacity);
+		return new_data_begin;
+	}
+	// The resize_in_place function attempts to grow the existing block using the allocator hooks. An expanded
+	// block does not move, so the elements only need to be moved if the location requires it (which in turn
+	// requires trivial relocation since the ranges overlap). A reallocated block may move (as by memcpy), so
+	// the reallocate hook is only used for trivially relocatable elements. Returns nullptr if it fails. (The hooks
+	// are not used for over-aligned capacity, since the block is not the allocation.)
+
+	constexpr pointer resize_in_place(size_t new_cap, pointer data_begin, pointer data_end, size_t front_gap)
+	{
+		size_t size = data_end - data_begin;
+		size_t offset = data_begin - m_capacity_begin;
+
+		if constexpr (sequence_expandable_allocator<allocator_type> && !over_aligned)
+		{
+			if ((sequence_trivially_relocatable<T> || offset == front_gap) &&
+				allocator().expand(m_capacity_begin, capacity(), new_cap))
+			{
+				count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, (new_cap - capacity()) * sizeof(value_type));
+				m_capacity_end = m_capacity_begin + new_cap;
+				if (offset != front_gap)
+					relocate(data_begin, data_end, m_capacity_begin + front_gap);
+				return m_capacity_begin + front_gap;
+			}
+		}
+		if constexpr (sequence_reallocatable_allocator<allocator_type> && sequence_trivially_relocatable<T> && !over_aligned)
 		{
-			std::uninitialized_move(data_begin, data_end, new_capacity.capacity_begin() + offset);
-			destroy_data(data_begin, data_end);
+			count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, (new_cap - capacity()) * sizeof(value_type));
+			m_capacity_begin = allocator().reallocate(m_capacity_begin, capacity(), new_cap);
+			m_capacity_end = m_capacity_begin + new_cap;
+			if (offset != front_gap)
+				relocate(m_capacity_begin + offset, m_capacity_begin + offset + size, m_capacity_begin + front_gap);
+			return m_capacity_begin + front_gap;
 		}
-		this->swap(new_capacity);
+		return nullptr;
+	}
+	constexpr void deallocate()
+	{
+		if (m_capacity_begin)
+			sequence_deallocate<capacity_alignment<T, TRAITS>>(allocator(), m_capacity_begin, capacity());
+		m_capacity_begin = m_capacity_end = nullptr;
+	}
+
+	// The adopt_capacity function deallocates the capacity and takes over a block of 'cap' elements allocated by
+	// the allocator. The release_capacity function gives up the capacity without deallocating it. (Over-aligned
+	// capacity is not the whole allocation, so it cannot change hands.)
+
+	constexpr void adopt_capacity(pointer begin, size_t cap) requires (!over_aligned)
+	{
+		deallocate();
+		m_capacity_begin = begin;
+		m_capacity_end = begin + cap;
+	}
+	constexpr void release_capacity() requires (!over_aligned)
+	{
+		m_capacity_begin = m_capacity_end = nullptr;
 	}
 
-	void swap(dynamic_capacity& rhs)
+	// The allocator functions implement the std::allocator_traits propagation rules. The capacity
+	// (but not the allocator) is exchanged by swap_capacity. The elements must already have been
+	// destroyed when copy_allocator is called, since it may need to deallocate the capacity.
+
+	constexpr void swap_allocator(dynamic_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), rhs.allocator());
+		else
+			assert(allocator_traits::is_always_equal::value || allocator() == rhs.allocator());
+	}
+	constexpr void copy_allocator(const dynamic_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (!allocator_traits::is_always_equal::value && allocator() != rhs.allocator())
+				deallocate();
+			allocator() = rhs.allocator();
+		}
+	}
+	// The move_allocator function returns true if the capacity of 'rhs' can be taken over by a move assignment.
+	// Otherwise the elements must be moved individually into capacity obtained from this allocator. When the
+	// allocator propagates, the allocators are exchanged so that 'rhs' can take (and later deallocate) the
+	// current capacity.
+	constexpr bool move_allocator(dynamic_capacity& rhs)
+	{
+		if constexpr (allocator_traits::is_always_equal::value)
+			return true;
+		else if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+		{
+			std::swap(allocator(), rhs.allocator());
+			return true;
+		}
+		else
+			return allocator() == rhs.allocator();
+	}
+	constexpr void swap_capacity(dynamic_capacity& rhs)
 	{
 		std::swap(m_capacity_begin, rhs.m_capacity_begin);
 		std::swap(m_capacity_end, rhs.m_capacity_end);
 	}
+	constexpr void swap_capacity(dynamic_capacity& rhs, pointer& data_begin, pointer& data_end,
+					   pointer& rhs_data_begin, pointer& rhs_data_end)
+	{
+		swap_capacity(rhs);
+		std::swap(data_begin, rhs_data_begin);
+		std::swap(data_end, rhs_data_end);
+	}
 
-	using deleter_type = decltype([](void* p){ delete p; });
-	std::unique_ptr<void, deleter_type> m_capacity_begin;
-	pointer m_capacity_end;
+	pointer m_capacity_begin = nullptr;
+	pointer m_capacity_end = nullptr;
+};
+
+
+// buffered_capacity - This is the capacity base class for BUFFERED storage. The capacity pointers point into the
+// small object buffer until a capacity larger than the buffer is needed, so the data accessors are the same as
+// for dynamic_capacity (no branching on the buffer state). The capacity is never smaller than the buffer.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class buffered_capacity : private ALLOC
+{
+	using value_type = T;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+	using allocator_traits = std::allocator_traits<ALLOC>;
+	using buffer_type = fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	buffered_capacity() = default;
+	constexpr explicit buffered_capacity(const allocator_type& alloc) : allocator_type(alloc) {}
+	constexpr buffered_capacity(size_t cap, const allocator_type& alloc = allocator_type()) : allocator_type(alloc)
+	{
+		if (cap > m_buffer.capacity())
+		{
+			auto [begin, count] = sequence_allocate<capacity_alignment<T, TRAITS>>(allocator(), cap);
+			m_capacity_begin = begin;
+			m_capacity_end = begin + count;
+			count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
+		}
+	}
+	buffered_capacity(const buffered_capacity&) = delete;
+	constexpr ~buffered_capacity()
+	{
+		deallocate();
+	}
+	buffered_capacity& operator=(const buffered_capacity&) = delete;
+
+	constexpr allocator_type get_allocator() const { return allocator(); }
+
+	constexpr size_t capacity() const { return capacity_end() - capacity_begin(); }
+	constexpr pointer capacity_begin() { return m_capacity_begin; }
+	constexpr pointer capacity_end() { return m_capacity_end; }
+	constexpr const_pointer capacity_begin() const { return m_capacity_begin; }
+	constexpr const_pointer capacity_end() const { return m_capacity_end; }
+
+	constexpr bool is_dynamic() const { return m_capacity_begin != m_buffer.capacity_begin(); }
+
+protected:
+
+	constexpr allocator_type& allocator() { return *this; }
+	constexpr const allocator_type& allocator() const { return *this; }
+
+	// The reallocate function moves the elements into a new capacity, placing them according to the location
+	// (or the 'front_gap' function), and returns the new beginning of the data. A capacity which fits in the
+	// buffer is satisfied by the buffer. If the elements are already in the buffer, this does nothing (the buffer
+	// capacity cannot change).
+
+	constexpr pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end)
+	{
+		return reallocate(new_cap, data_begin, data_end, [](size_t cap, size_t size){ return aligned_front_gap<T, TRAITS>(cap, size); });
+	}
+	template<std::regular_invocable<size_t, size_t> FUNC>
+	constexpr pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end, FUNC front_gap)
+	{
+		auto size = data_end - data_begin;
+
+		if (new_cap <= m_buffer.capacity())
+		{
+			if (!is_dynamic())
+				return data_begin;
+
+			count_event<T, TRAITS>(sequence_event::REALLOCATION);
+			count_event<T, TRAITS>(sequence_event::REBUFFER);
+			auto new_data_begin = m_buffer.capacity_begin() + front_gap(m_buffer.capacity(), size);
+			relocate(data_begin, data_end, new_data_begin);
+			deallocate();
+			return new_data_begin;
+		}
+
+		auto [new_capacity_begin, count] = sequence_allocate<capacity_alignment<T, TRAITS>>(allocator(), new_cap);
+		count_event<T, TRAITS>(sequence_event::REALLOCATION);
+		count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
+		if (!is_dynamic())
+			count_event<T, TRAITS>(sequence_event::SPILL);
+		auto new_data_begin = new_capacity_begin + front_gap(count, size);
+		try
+		{
+			relocate(data_begin, data_end, new_data_begin);
+		}
+		catch (...)
+		{
+			sequence_deallocate<capacity_alignment<T, TRAITS>>(allocator(), new_capacity_begin, count);
+			throw;
+		}
+		deallocate();
+		m_capacity_begin = new_capacity_begin;
+		m_capacity_end = new_capacity_begin + count;
+		return new_data_begin;
+	}
+	constexpr void deallocate()
+	{
+		if (is_dynamic())
+			sequence_deallocate<capacity_alignment<T, TRAITS>>(allocator(), m_capacity_begin, capacity());
+		m_capacity_begin = m_buffer.capacity_begin();
+		m_capacity_end = m_buffer.capacity_end();
+	}
+
+	// The allocator functions are the same as those of dynamic_capacity.
+
+	constexpr void swap_allocator(buffered_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), rhs.allocator());
+		else
+			assert(allocator_traits::is_always_equal::value || allocator() == rhs.allocator());
+	}
+	constexpr void copy_allocator(const buffered_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (!allocator_traits::is_always_equal::value && allocator() != rhs.allocator())
+				deallocate();
+			allocator() = rhs.allocator();
+		}
+	}
+	constexpr bool move_allocator(buffered_capacity& rhs)
+	{
+		if constexpr (allocator_traits::is_always_equal::value)
+			return true;
+		else if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+		{
+			std::swap(allocator(), rhs.allocator());
+			return true;
+		}
+		else
+			return allocator() == rhs.allocator();
+	}
+
+	// The swap_capacity function exchanges the capacities and the elements they hold, and updates the data
+	// pointers to match. Dynamic capacities simply change hands. Buffered elements are moved into the other buffer
+	// at the same offset (which is valid for every location), so no temporary is needed: a buffered element is
+	// relocated into the other buffer if that slot is free there, or swapped with the element in the slot if both
+	// buffers hold one. So swapping buffered sequences of n and m elements at the same offset is min(n, m) swaps
+	// and |n - m| relocations. Trivially relocatable elements are swapped as bytes across the occupied slots.
+
+	constexpr void swap_capacity(buffered_capacity& rhs, pointer& data_begin, pointer& data_end,
+					   pointer& rhs_data_begin, pointer& rhs_data_end)
+	{
+		if (is_dynamic() && rhs.is_dynamic())
+		{
+			std::swap(m_capacity_begin, rhs.m_capacity_begin);
+			std::swap(m_capacity_end, rhs.m_capacity_end);
+			std::swap(data_begin, rhs_data_begin);
+			std::swap(data_end, rhs_data_end);
+			return;
+		}
+		if (is_dynamic())
+		{
+			rhs.swap_capacity(*this, rhs_data_begin, rhs_data_end, data_begin, data_end);
+			return;
+		}
+
+		size_t lhs_first = data_begin - m_capacity_begin;
+		size_t lhs_last = data_end - m_capacity_begin;
+		size_t rhs_first = rhs_data_begin - rhs.m_capacity_begin;
+		size_t rhs_last = rhs_data_end - rhs.m_capacity_begin;
+		auto rhs_buffer = rhs.m_buffer.capacity_begin();
+
+		if (rhs.is_dynamic())
+		{
+			// The buffered elements move into the free buffer of 'rhs', which hands over its dynamic capacity.
+			relocate(data_begin, data_end, rhs_buffer + lhs_first);
+			m_capacity_begin = rhs.m_capacity_begin;
+			m_capacity_end = rhs.m_capacity_end;
+			rhs.m_capacity_begin = rhs_buffer;
+			rhs.m_capacity_end = rhs.m_buffer.capacity_end();
+		}
+		else
+			exchange_buffers(lhs_first, lhs_last, rhs_first, rhs_last, rhs);
+
+		data_begin = m_capacity_begin + rhs_first;
+		data_end = m_capacity_begin + rhs_last;
+		rhs_data_begin = rhs.m_capacity_begin + lhs_first;
+		rhs_data_end = rhs.m_capacity_begin + lhs_last;
+	}
+
+private:
+
+	// The exchange_buffers function exchanges the elements in the slots [first, last) of this buffer and of the
+	// buffer of 'rhs'. Slots which both occupy are swapped and the others relocated, in either order, since the
+	// buffers do not overlap.
+
+	constexpr void exchange_buffers(size_t lhs_first, size_t lhs_last, size_t rhs_first, size_t rhs_last,
+									buffered_capacity& rhs)
+	{
+		auto lhs_buffer = m_buffer.capacity_begin();
+		auto rhs_buffer = rhs.m_buffer.capacity_begin();
+
+		if constexpr (sequence_trivially_relocatable<T>)
+			if !consteval
+			{
+				size_t first = std::min(lhs_first, rhs_first);
+				size_t last = std::max(lhs_last, rhs_last);
+				std::swap_ranges(reinterpret_cast<unsigned char*>(lhs_buffer + first),
+								 reinterpret_cast<unsigned char*>(lhs_buffer + last),
+								 reinterpret_cast<unsigned char*>(rhs_buffer + first));
+				return;
+			}
+
+		size_t both_first = std::max(lhs_first, rhs_first);
+		size_t both_last = std::max(both_first, std::min(lhs_last, rhs_last));
+		auto relocate_unshared = [=](pointer from, pointer to, size_t first, size_t last)
+		{
+			if (both_first == both_last)
+				relocate(from + first, from + last, to + first);
+			else
+			{
+				relocate(from + first, from + both_first, to + first);
+				relocate(from + both_last, from + last, to + both_last);
+			}
+		};
+		std::swap_ranges(lhs_buffer + both_first, lhs_buffer + both_last, rhs_buffer + both_first);
+		relocate_unshared(lhs_buffer, rhs_buffer, lhs_first, lhs_last);
+		relocate_unshared(rhs_buffer, lhs_buffer, rhs_first, rhs_last);
+	}
+
+	buffer_type m_buffer;
+	pointer m_capacity_begin = m_buffer.capacity_begin();
+	pointer m_capacity_end = m_buffer.capacity_end();
 };
 
 
 // dynamic_sequence_storage - Helper class for sequence which provides the 3 different element management strategies
-// for dynamically allocated variable capacity sequences.
+// for dynamically allocated variable capacity sequences. The capacity is managed by the CAPACITY base class
+// (dynamic_capacity for VARIABLE storage, buffered_capacity for BUFFERED storage).
 
-template<sequence_location_lits LOC, typename T, sequence_traits TRAITS>
+template<sequence_location_lits LOC, typename T, sequence_traits TRAITS, typename ALLOC,
+		 typename CAPACITY = dynamic_capacity<T, TRAITS, ALLOC>>
 class dynamic_sequence_storage
 {
 	static_assert(false, "An unimplemented specialization of variable_sequence_storage was instantiated.");
 };
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::FRONT, T, TRAITS> : public dynamic_capacity<T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC, typename CAPACITY>
+class dynamic_sequence_storage<sequence_location_lits::FRONT, T, TRAITS, ALLOC, CAPACITY> : public CAPACITY
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
+	using inherited = CAPACITY;
+	using allocator_traits = std::allocator_traits<ALLOC>;
 
 public:
 
+	using allocator_type = ALLOC;
+
+	using inherited::get_allocator;
 	using inherited::capacity;
 	using inherited::capacity_begin;
 	using inherited::capacity_end;
 
 	dynamic_sequence_storage() = default;
-	dynamic_sequence_storage(const dynamic_sequence_storage& rhs) : inherited(rhs.size())
+	constexpr explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	constexpr dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin());
-		m_data_end = capacity_end();
+		copy_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		m_data_end = capacity_begin() + rhs.size();
 	}
-	dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage(dynamic_sequence_storage&& rhs) : inherited(rhs.get_allocator())
 	{
-		swap(rhs);
+		swap_data(rhs);
 	}
-	dynamic_sequence_storage(std::initializer_list<value_type> il) : inherited(il.size())
+	constexpr dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc)
 	{
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
-		m_data_end = capacity_end();
+		copy_data(il.begin(), il.end(), capacity_begin());
+		m_data_end = capacity_begin() + il.size();
 	}
 	template<sequence_storage_implementation SEQ>
-	dynamic_sequence_storage(size_t cap, SEQ&& rhs) :  inherited(cap)
+	constexpr dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc = allocator_type()) :
+		inherited(cap, alloc)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
 		m_data_end = capacity_begin() + rhs.size();
 	}
-	~dynamic_sequence_storage()
+	constexpr ~dynamic_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	// Copy assignment assigns over the existing elements if the capacity holds those of 'rhs' (see
+	// assign_elements). Otherwise they are copied into a capacity sized for them (rather than for 'rhs'). A
+	// capacity which the propagated allocator could not deallocate is given up first.
+
+	constexpr dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
 	{
-		clear();
-		if (rhs.capacity() > capacity())
-			inherited::reallocate(rhs.capacity(), 0, nullptr, nullptr);
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin());
-		m_data_end = capacity_begin() + rhs.size();
+		if (this == &rhs)
+			return *this;
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value &&
+					  !allocator_traits::is_always_equal::value)
+		{
+			if (get_allocator() != rhs.get_allocator())
+				reset();
+		}
+		inherited::copy_allocator(rhs);
+		if (rhs.size() <= capacity())
+			assign_elements<sequence_location_lits::FRONT>(*this, rhs);
+		else
+		{
+			clear();
+			assign_data(rhs.data_begin(), rhs.size(), std::max(rhs.size(), TRAITS.capacity));
+		}
 		return *this;
 	}
-	dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
 	{
-		clear();
-		swap(rhs);
+		// For LAZY discard the replaced elements are swapped into 'rhs' (if its capacity can be taken over).
+		if constexpr (TRAITS.discard != sequence_discard_lits::LAZY)
+			clear();
+		if (inherited::move_allocator(rhs))
+			swap_data(rhs);
+		else
+		{
+			clear();
+			assign_data(std::make_move_iterator(rhs.data_begin()), rhs.size(), rhs.capacity());
+		}
 		return *this;
 	}
 
-	value_type* data_begin() { return capacity_begin(); }
-	value_type* data_end() { return m_data_end; }
-	const value_type* data_begin() const { return capacity_begin(); }
-	const value_type* data_end() const { return m_data_end; }
-	size_t size() const { return data_end() - data_begin(); }
+	constexpr value_type* data_begin() { return capacity_begin(); }
+	constexpr value_type* data_end() { return m_data_end; }
+	constexpr const value_type* data_begin() const { return capacity_begin(); }
+	constexpr const value_type* data_end() const { return m_data_end; }
+	constexpr size_t size() const { return data_end() - data_begin(); }
 
-	void swap(dynamic_sequence_storage& rhs)
+	constexpr void swap(dynamic_sequence_storage& rhs)
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_end, rhs.m_data_end);
+		inherited::swap_allocator(rhs);
+		swap_data(rhs);
 	}
 
-	void reallocate(size_t new_cap)
+	constexpr void reallocate(size_t new_cap)
 	{
 		assert(size() <= new_cap);
 
 		auto current_size = size();
-		inherited::reallocate(new_cap, 0, data_begin(), data_end());
-		m_data_end = capacity_begin() + current_size;
+		m_data_end = inherited::reallocate(new_cap, data_begin(), data_end()) + current_size;
 	}
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
@@ -153,51 +550,91 @@ public:
 		if (size() == 0 || pos == data_end())
 			add_back(std::forward<ARGS>(args)...);
 		else
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
 			pos = back_add_at(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
+		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
+		return back_add_range_at(data_end(), pos, first, count, [this](size_t n){ m_data_end += n; });
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		add_at(data_begin(), std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		assert(size() < capacity());
 
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
+		std::construct_at(data_end(), std::forward<ARGS>(args)...);
 		++m_data_end;
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		construct_data(m_data_end, count, std::forward<ARGS>(args)...);
+		m_data_end += count;
+	}
+
+	// The reset function clears the sequence and deallocates any dynamic capacity.
+
+	constexpr void reset()
+	{
+		clear();
+		inherited::deallocate();
+		m_data_end = capacity_begin();
 	}
+	// The adopt function clears the sequence and takes over the capacity and elements of a block, whose elements
+	// must be at the front. The release function gives up the capacity and elements, leaving no capacity.
 
-	void clear()
+	constexpr void adopt(const sequence_block<T>& block)
+	{
+		assert(block.front_gap == 0 && block.size <= block.capacity);
+
+		clear();
+		inherited::adopt_capacity(block.capacity_begin, block.capacity);
+		m_data_end = capacity_begin() + block.size;
+	}
+	constexpr sequence_block<T> release()
+	{
+		sequence_block<T> block{capacity_begin(), capacity(), 0, size()};
+		inherited::release_capacity();
+		m_data_end = capacity_begin();
+		return block;
+	}
+	constexpr void clear()
 	{
 		auto end = data_end();
 		m_data_end = capacity_begin();
 		destroy_data(data_begin(), end);
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		back_erase(data_begin(), data_end(), erase_begin, erase_end,
 				   [this](size_t count){ m_data_end -= count; });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		back_erase(data_begin(), data_end(), element, [this](){ --m_data_end; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
 		erase(data_begin());
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -207,134 +644,224 @@ public:
 
 private:
 
-	value_type* m_data_end = nullptr;
+	// The swap_data function exchanges the capacity and the elements, but not the allocator.
+
+	constexpr void swap_data(dynamic_sequence_storage& rhs)
+	{
+		auto begin = data_begin();
+		auto rhs_begin = rhs.data_begin();
+		inherited::swap_capacity(rhs, begin, m_data_end, rhs_begin, rhs.m_data_end);
+	}
+
+	// The assign_data function constructs 'size' elements from 'first' after first ensuring a capacity of at
+	// least 'cap'. The sequence must be empty.
+
+	template<typename ITER>
+	constexpr void assign_data(ITER first, size_t size, size_t cap)
+	{
+		assert(this->size() == 0);
+
+		if (cap > capacity())
+			inherited::reallocate(cap, nullptr, nullptr);
+		copy_data_n(first, size, capacity_begin());
+		m_data_end = capacity_begin() + size;
+	}
+
+	value_type* m_data_end = capacity_begin();
 };
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : public dynamic_capacity<T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC, typename CAPACITY>
+class dynamic_sequence_storage<sequence_location_lits::BACK, T, TRAITS, ALLOC, CAPACITY> : public CAPACITY
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
+	using inherited = CAPACITY;
+	using allocator_traits = std::allocator_traits<ALLOC>;
 
 public:
 
+	using allocator_type = ALLOC;
+
+	using inherited::get_allocator;
 	using inherited::capacity;
 	using inherited::capacity_begin;
 	using inherited::capacity_end;
 
 	dynamic_sequence_storage() = default;
-	dynamic_sequence_storage(const dynamic_sequence_storage& rhs) : inherited(rhs.size())
+	constexpr explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	constexpr dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
 	{
-		m_data_begin = capacity_begin();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		m_data_begin = capacity_end() - rhs.size();
+		copy_data(rhs.data_begin(), rhs.data_end(), m_data_begin);
 	}
-	dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage(dynamic_sequence_storage&& rhs) : inherited(rhs.get_allocator())
 	{
-		swap(rhs);
+		swap_data(rhs);
 	}
-	dynamic_sequence_storage(std::initializer_list<value_type> il) : inherited(il.size())
+	constexpr dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc)
 	{
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
-		m_data_begin = capacity_begin();
+		m_data_begin = capacity_end() - il.size();
+		copy_data(il.begin(), il.end(), m_data_begin);
 	}
 	template<sequence_storage_implementation SEQ>
-	dynamic_sequence_storage(size_t cap, SEQ&& rhs) :  inherited(cap)
+	constexpr dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc = allocator_type()) :
+		inherited(cap, alloc)
 	{
 		m_data_begin = capacity_end() - rhs.size();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		move_data(rhs.data_begin(), rhs.data_end(), m_data_begin);
 	}
-	~dynamic_sequence_storage()
+	constexpr ~dynamic_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	constexpr dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
 	{
-		clear();
-		if (rhs.capacity() > capacity())
-			inherited::reallocate(rhs.capacity(), 0, nullptr, nullptr);
-		auto begin = capacity_end() - rhs.size();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
-		m_data_begin = begin;
+		if (this == &rhs)
+			return *this;
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value &&
+					  !allocator_traits::is_always_equal::value)
+		{
+			if (get_allocator() != rhs.get_allocator())
+				reset();
+		}
+		inherited::copy_allocator(rhs);
+		if (rhs.size() <= capacity())
+			assign_elements<sequence_location_lits::BACK>(*this, rhs);
+		else
+		{
+			clear();
+			assign_data(rhs.data_begin(), rhs.size(), std::max(rhs.size(), TRAITS.capacity));
+		}
 		return *this;
 	}
-	dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
 	{
-		clear();
-		swap(rhs);
+		// For LAZY discard the replaced elements are swapped into 'rhs' (if its capacity can be taken over).
+		if constexpr (TRAITS.discard != sequence_discard_lits::LAZY)
+			clear();
+		if (inherited::move_allocator(rhs))
+			swap_data(rhs);
+		else
+		{
+			clear();
+			assign_data(std::make_move_iterator(rhs.data_begin()), rhs.size(), rhs.capacity());
+		}
 		return *this;
 	}
 
-	value_type* data_begin() { return m_data_begin; }
-	value_type* data_end() { return capacity_end(); }
-	const value_type* data_begin() const { return m_data_begin; }
-	const value_type* data_end() const { return capacity_end(); }
-	size_t size() const { return data_end() - data_begin(); }
+	constexpr value_type* data_begin() { return m_data_begin; }
+	constexpr value_type* data_end() { return capacity_end(); }
+	constexpr const value_type* data_begin() const { return m_data_begin; }
+	constexpr const value_type* data_end() const { return capacity_end(); }
+	constexpr size_t size() const { return data_end() - data_begin(); }
 
-	void swap(dynamic_sequence_storage& rhs)
+	constexpr void swap(dynamic_sequence_storage& rhs)
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_begin, rhs.m_data_begin);
+		inherited::swap_allocator(rhs);
+		swap_data(rhs);
 	}
 
-	void reallocate(size_t new_cap)
+	constexpr void reallocate(size_t new_cap)
 	{
 		assert(size() <= new_cap);
 
-		auto current_size = size();
-		inherited::reallocate(new_cap, TRAITS.front_gap(new_cap, current_size), data_begin(), data_end());
-		m_data_begin = capacity_end() - current_size;
+		m_data_begin = inherited::reallocate(new_cap, data_begin(), data_end());
 	}
 
 	template<typename... ARGS>
-	iterator add_at(value_type* pos, ARGS&&... args)
+	constexpr iterator add_at(value_type* pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
 
 		if (size() == 0 || pos == data_begin())
+		{
 			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
 		else
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
 			pos = front_add_at(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
+		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
+		return front_add_range_at(data_begin(), pos, first, count, [this](size_t n){ m_data_begin -= n; });
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		assert(size() < capacity());
 
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		std::construct_at(data_begin() - 1, std::forward<ARGS>(args)...);
 		--m_data_begin;
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		add_at(data_end(), std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		while (count--)
-			add_front(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size());
+		front_add_n(m_data_begin, data_end(), count, [this](size_t n){ m_data_begin -= n; }, std::forward<ARGS>(args)...);
 	}
 
-	void clear()
+	// The reset function clears the sequence and deallocates any dynamic capacity.
+
+	constexpr void reset()
+	{
+		clear();
+		inherited::deallocate();
+		m_data_begin = capacity_end();
+	}
+	// The adopt function clears the sequence and takes over the capacity and elements of a block, whose elements
+	// must be at the back. The release function gives up the capacity and elements, leaving no capacity.
+
+	constexpr void adopt(const sequence_block<T>& block)
+	{
+		assert(block.size <= block.capacity && block.front_gap == block.capacity - block.size);
+
+		clear();
+		inherited::adopt_capacity(block.capacity_begin, block.capacity);
+		m_data_begin = capacity_end() - block.size;
+	}
+	constexpr sequence_block<T> release()
+	{
+		sequence_block<T> block{capacity_begin(), capacity(), size_t(data_begin() - capacity_begin()), size()};
+		inherited::release_capacity();
+		m_data_begin = capacity_end();
+		return block;
+	}
+	constexpr void clear()
 	{
 		auto begin = data_begin();
 		m_data_begin = capacity_end();
 		destroy_data(begin, data_end());
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		front_erase(data_begin(), data_end(), erase_begin, erase_end,
 					[this](size_t count){ m_data_begin += count; });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		front_erase(data_begin(), data_end(), element, [this](){ ++m_data_begin; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
@@ -342,7 +869,7 @@ public:
 		++m_data_begin;
 		dst->~value_type();
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -351,96 +878,145 @@ public:
 
 private:
 
-	value_type* m_data_begin = nullptr;
+	// The swap_data function exchanges the capacity and the elements, but not the allocator.
+
+	constexpr void swap_data(dynamic_sequence_storage& rhs)
+	{
+		auto end = data_end();
+		auto rhs_end = rhs.data_end();
+		inherited::swap_capacity(rhs, m_data_begin, end, rhs.m_data_begin, rhs_end);
+	}
+
+	// The assign_data function constructs 'size' elements from 'first' after first ensuring a capacity of at
+	// least 'cap'. The sequence must be empty.
+
+	template<typename ITER>
+	constexpr void assign_data(ITER first, size_t size, size_t cap)
+	{
+		assert(this->size() == 0);
+
+		if (cap > capacity())
+			inherited::reallocate(cap, nullptr, nullptr);
+		auto begin = capacity_end() - size;
+		copy_data_n(first, size, begin);
+		m_data_begin = begin;
+	}
+
+	value_type* m_data_begin = capacity_end();
 };
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : public dynamic_capacity<T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC, typename CAPACITY>
+class dynamic_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS, ALLOC, CAPACITY> :
+	public CAPACITY, private insertion_bias<T, TRAITS>
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
+	using inherited = CAPACITY;
+	using bias = insertion_bias<T, TRAITS>;
+	using allocator_traits = std::allocator_traits<ALLOC>;
 
 public:
 
+	using allocator_type = ALLOC;
+
+	using inherited::get_allocator;
 	using inherited::capacity;
 	using inherited::capacity_begin;
 	using inherited::capacity_end;
 
 	dynamic_sequence_storage() = default;
-	dynamic_sequence_storage(const dynamic_sequence_storage& rhs) : inherited(rhs.size())
+	constexpr explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	constexpr dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
 	{
-		m_data_begin = capacity_begin();
-		m_data_end = capacity_end();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		m_data_begin = capacity_begin() + aligned_front_gap<T, TRAITS>(capacity(), rhs.size());
+		m_data_end = m_data_begin + rhs.size();
+		copy_data(rhs.data_begin(), rhs.data_end(), m_data_begin);
 	}
-	dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage(dynamic_sequence_storage&& rhs) : inherited(rhs.get_allocator())
 	{
-		swap(rhs);
+		swap_data(rhs);
 	}
-	dynamic_sequence_storage(std::initializer_list<value_type> il) : inherited(il.size())
+	constexpr dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc)
 	{
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
-		m_data_begin = capacity_begin();
-		m_data_end = capacity_end();
+		m_data_begin = capacity_begin() + aligned_front_gap<T, TRAITS>(capacity(), il.size());
+		m_data_end = m_data_begin + il.size();
+		copy_data(il.begin(), il.end(), m_data_begin);
 	}
 	template<sequence_storage_implementation SEQ>
-	dynamic_sequence_storage(size_t cap, SEQ&& rhs) :  inherited(cap)
+	constexpr dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc = allocator_type()) :
+		inherited(cap, alloc)
 	{
 		auto size = rhs.size();
-		m_data_begin = capacity_begin() + TRAITS.front_gap(capacity(), size);
+		m_data_begin = capacity_begin() + aligned_front_gap<T, TRAITS>(capacity(), size);
 		m_data_end = m_data_begin + size;
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		move_data(rhs.data_begin(), rhs.data_end(), m_data_begin);
 	}
-	~dynamic_sequence_storage()
+	constexpr ~dynamic_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	constexpr dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
 	{
-		clear();
-		if (rhs.capacity() > capacity())
-			inherited::reallocate(rhs.capacity(), 0, nullptr, nullptr);
-		auto begin = capacity_begin() + TRAITS.front_gap(capacity(), rhs.size());
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
-		m_data_begin = begin;
-		m_data_end = m_data_begin + rhs.size();
+		if (this == &rhs)
+			return *this;
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value &&
+					  !allocator_traits::is_always_equal::value)
+		{
+			if (get_allocator() != rhs.get_allocator())
+				reset();
+		}
+		inherited::copy_allocator(rhs);
+		if (rhs.size() <= capacity())
+			assign_elements<sequence_location_lits::MIDDLE>(*this, rhs);
+		else
+		{
+			clear();
+			assign_data(rhs.data_begin(), rhs.size(), std::max(rhs.size(), TRAITS.capacity));
+		}
 		return *this;
 	}
-	dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	constexpr dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
 	{
-		clear();
-		swap(rhs);
+		// For LAZY discard the replaced elements are swapped into 'rhs' (if its capacity can be taken over).
+		if constexpr (TRAITS.discard != sequence_discard_lits::LAZY)
+			clear();
+		if (inherited::move_allocator(rhs))
+			swap_data(rhs);
+		else
+		{
+			clear();
+			assign_data(std::make_move_iterator(rhs.data_begin()), rhs.size(), rhs.capacity());
+		}
 		return *this;
 	}
 
-	value_type* data_begin() { return m_data_begin; }
-	value_type* data_end() { return m_data_end; }
-	const value_type* data_begin() const { return m_data_begin; }
-	const value_type* data_end() const { return m_data_end; }
-	size_t size() const { return m_data_end - m_data_begin; }
+	constexpr value_type* data_begin() { return m_data_begin; }
+	constexpr value_type* data_end() { return m_data_end; }
+	constexpr const value_type* data_begin() const { return m_data_begin; }
+	constexpr const value_type* data_end() const { return m_data_end; }
+	constexpr size_t size() const { return m_data_end - m_data_begin; }
 
-	void swap(dynamic_sequence_storage& rhs)
+	constexpr void swap(dynamic_sequence_storage& rhs)
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_begin, rhs.m_data_begin);
-		std::swap(m_data_end, rhs.m_data_end);
+		inherited::swap_allocator(rhs);
+		swap_data(rhs);
 	}
 
-	void reallocate(size_t new_cap)
+	constexpr void reallocate(size_t new_cap)
 	{
 		assert(size() <= new_cap);
 
 		auto current_size = size();
-		auto offset = TRAITS.front_gap(new_cap, current_size);
-		inherited::reallocate(new_cap, offset, data_begin(), data_end());
-		m_data_begin = capacity_begin() + offset;
+		m_data_begin = inherited::reallocate(new_cap, data_begin(), data_end(),
+											 [this](size_t cap, size_t size){ return bias::biased_front_gap(cap, size); });
 		m_data_end = m_data_begin + current_size;
 	}
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
@@ -449,70 +1025,170 @@ public:
 		auto dend = data_end();
 
 		if (size() == 0 || pos == dend)
+		{
 			add_back(std::forward<ARGS>(args)...);
+			pos = data_end() - 1;
+		}
 		else if (pos == dbeg)
+		{
 			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
 
 		else if (pos - dbeg >= dend - pos)			// Inserting closer to the end--add at back.
 		{
+			if (m_data_end == capacity_end() && !constructible_in_gap(dbeg, dend, args...))
+				return add_at(pos, value_type(std::forward<ARGS>(args)...));
+			bias::count_back();
 			if (m_data_end == capacity_end())
 			{
-				recenter();
-				pos -= capacity_end() - m_data_end;
+				auto index = pos - m_data_begin;
+				recenter(false);
+				pos = m_data_begin + index;
 			}
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
 			pos = back_add_at(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
 		}
 		else										// Inserting closer to the beginning--add at front.
 		{
+			if (m_data_begin == capacity_begin() && !constructible_in_gap(dbeg, dend, args...))
+				return add_at(pos, value_type(std::forward<ARGS>(args)...));
+			bias::count_front();
 			if (m_data_begin == capacity_begin())
 			{
-				recenter();
-				pos += m_data_begin - capacity_begin();
+				auto index = pos - m_data_begin;
+				recenter(true);
+				pos = m_data_begin + index;
 			}
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
 			pos = front_add_at(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
 		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		// The gap is opened at the nearer end if there is room there, otherwise at the other end if there is
+		// room there. If neither end has room, the elements are first repositioned to make room at the nearer end.
+		size_t front_room = m_data_begin - capacity_begin();
+		size_t back_room = capacity_end() - m_data_end;
+		bool at_back = pos - m_data_begin >= m_data_end - pos;
+		if ((at_back ? back_room : front_room) < count)
+		{
+			if ((at_back ? front_room : back_room) >= count)
+				at_back = !at_back;
+			else
+			{
+				auto index = pos - m_data_begin;
+				auto size = this->size();
+				auto extra = front_room + back_room - count;
+				auto front_gap = at_back ? extra / 2 : count + (extra - extra / 2);
+				reposition<inherited>(capacity_begin(), m_data_begin, m_data_end, front_gap, get_allocator());
+				m_data_begin = capacity_begin() + front_gap;
+				m_data_end = m_data_begin + size;
+				pos = m_data_begin + index;
+			}
+		}
+		if (at_back)
+		{
+			bias::count_back();
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
+			return back_add_range_at(m_data_end, pos, first, count, [this](size_t n){ m_data_end += n; });
+		}
+		else
+		{
+			bias::count_front();
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
+			return front_add_range_at(m_data_begin, pos, first, count, [this](size_t n){ m_data_begin -= n; });
+		}
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
 
+		if (m_data_begin == capacity_begin() && !constructible_in_gap(data_begin(), data_end(), args...))
+			return add_front(value_type(std::forward<ARGS>(args)...));
+		bias::count_front();
 		if (m_data_begin == capacity_begin())
-			recenter();
-		new(m_data_begin - 1) value_type(std::forward<ARGS>(args)...);
+			recenter(true);
+		std::construct_at(m_data_begin - 1, std::forward<ARGS>(args)...);
 		--m_data_begin;
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
 
+		if (m_data_end == capacity_end() && !constructible_in_gap(data_begin(), data_end(), args...))
+			return add_back(value_type(std::forward<ARGS>(args)...));
+		bias::count_back();
 		if (m_data_end == capacity_end())
-			recenter();
-		new(m_data_end) value_type(std::forward<ARGS>(args)...);
+			recenter(false);
+		std::construct_at(m_data_end, std::forward<ARGS>(args)...);
 		++m_data_end;
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		// This is certainly not as optimized as it could be. The question is,
-		// how useful is resize for a middle location container?
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		// If there is not enough room at the back, the elements are first placed for the new size.
+		bias::count_back();
+		if (size_t(capacity_end() - m_data_end) < count)
+		{
+			count_event<T, TRAITS>(sequence_event::RECENTER);
+			auto size = this->size();
+			auto front_gap = bias::biased_front_gap(capacity(), size + count);
+			reposition<inherited>(capacity_begin(), m_data_begin, m_data_end, front_gap, get_allocator());
+			m_data_begin = capacity_begin() + front_gap;
+			m_data_end = m_data_begin + size;
+		}
+		construct_data(m_data_end, count, std::forward<ARGS>(args)...);
+		m_data_end += count;
+	}
+
+	// The reset function clears the sequence and deallocates any dynamic capacity.
+
+	constexpr void reset()
+	{
+		clear();
+		inherited::deallocate();
+		m_data_begin = m_data_end = capacity_begin() + bias::biased_front_gap(capacity(), 0);
 	}
+	// The adopt function clears the sequence and takes over the capacity and elements of a block, whose elements
+	// may be anywhere in it. The release function gives up the capacity and elements, leaving no capacity.
 
-	void clear()
+	constexpr void adopt(const sequence_block<T>& block)
+	{
+		assert(block.front_gap <= block.capacity && block.size <= block.capacity - block.front_gap);
+
+		clear();
+		inherited::adopt_capacity(block.capacity_begin, block.capacity);
+		m_data_begin = capacity_begin() + block.front_gap;
+		m_data_end = m_data_begin + block.size;
+	}
+	constexpr sequence_block<T> release()
+	{
+		sequence_block<T> block{capacity_begin(), capacity(), size_t(data_begin() - capacity_begin()), size()};
+		inherited::release_capacity();
+		m_data_begin = m_data_end = capacity_begin();
+		return block;
+	}
+	constexpr void clear()
 	{
 		auto begin = data_begin();
 		auto end = data_end();
-		m_data_begin = capacity_begin() + TRAITS.front_gap(capacity(), 0);
+		m_data_begin = capacity_begin() + bias::biased_front_gap(capacity(), 0);
 		m_data_end = m_data_begin;
 		destroy_data(begin, end);
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
 		if (erase_begin - data_begin() >= data_end() - erase_end)
@@ -522,7 +1198,7 @@ public:
 			front_erase(data_begin(), data_end(), erase_begin, erase_end,
 						[this](size_t count){ m_data_begin += count; });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
 		if (element - data_begin() >= data_end() - element)
@@ -530,14 +1206,14 @@ public:
 		else
 			front_erase(data_begin(), data_end(), element, [this](){ ++m_data_begin; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
 		data_begin()->~value_type();
 		++m_data_begin;
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -547,16 +1223,63 @@ public:
 
 private:
 
-	// This function recenters the elements to prepare for size growth. If the remaining space is odd, then the
-	// extra space will be at the front if we are making space at the front, otherwise it will be at the back.
+	// This function recenters the elements to prepare for size growth at the front (if 'at_front') or the back.
+	// The free space is divided according to the front bias (see ::recenter). If the capacity is fuller than
+	// 'recenter_fill' allows, the capacity grows instead (as the sequence grows it, see sequence_grow) so that a
+	// nearly full sequence does not recenter repeatedly. (The elements are still recentered if the bias leaves no
+	// room at the end being grown.) A capacity which cannot grow (the whole reservation of RESERVED storage) is
+	// recentered unless it is full.
 	
-	void recenter()
+	constexpr void recenter(bool at_front)
 	{
-		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
+		if (size() > TRAITS.recenter_fill * capacity() && (size() == capacity() || can_grow()))
+		{
+			if constexpr (requires (const inherited& c) { c.is_dynamic(); })
+				reallocate(sequence_grow<T, TRAITS>(capacity(), inherited::is_dynamic()));
+			else
+				reallocate(sequence_grow<T, TRAITS>(capacity(), true));
+			if (at_front ? m_data_begin != capacity_begin() : m_data_end != capacity_end())
+				return;
+		}
+
+		count_event<T, TRAITS>(sequence_event::RECENTER);
+		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end(),
+														   at_front, bias::front_bias(), capacity_granule<T, TRAITS>, get_allocator());
 		m_data_begin = capacity_begin() + front_gap;
 		m_data_end = capacity_end() - back_gap;
 	}
 
-	value_type* m_data_begin = nullptr;
-	value_type* m_data_end = nullptr;
+	constexpr bool can_grow() const
+	{
+		if constexpr (requires { inherited::reservation(); })
+			return capacity() < inherited::reservation();
+		else
+			return true;
+	}
+
+	// The swap_data function exchanges the capacity and the elements, but not the allocator.
+
+	constexpr void swap_data(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap_capacity(rhs, m_data_begin, m_data_end, rhs.m_data_begin, rhs.m_data_end);
+	}
+
+	// The assign_data function constructs 'size' elements from 'first' after first ensuring a capacity of at
+	// least 'cap'. The sequence must be empty.
+
+	template<typename ITER>
+	constexpr void assign_data(ITER first, size_t size, size_t cap)
+	{
+		assert(this->size() == 0);
+
+		if (cap > capacity())
+			inherited::reallocate(cap, nullptr, nullptr);
+		auto begin = capacity_begin() + aligned_front_gap<T, TRAITS>(capacity(), size);
+		copy_data_n(first, size, begin);
+		m_data_begin = begin;
+		m_data_end = m_data_begin + size;
+	}
+
+	value_type* m_data_begin = capacity_begin() + aligned_front_gap<T, TRAITS>(capacity(), 0);
+	value_type* m_data_end = m_data_begin;
 };
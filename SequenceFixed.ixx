@@ -1,5 +1,6 @@
 export module sequence:fixed;
 import :traits;
+import :statistics;
 import :utilities;
 
 import std;
@@ -10,31 +11,54 @@ import <assert.h>;
 
 // fixed_capacity - This is the base class for fixed_sequence_storage instantiations. It handles the capacity.
 
-template<typename T, size_t CAP> requires (CAP != 0)
+template<typename T, size_t CAP, size_t ALIGN = alignof(T)> requires (CAP != 0)
 class fixed_capacity
 {
 	using value_type = T;
 
+	static constexpr bool trivial = std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>;
+
 public:
 
-	fixed_capacity() {}
-	fixed_capacity(size_t cap) {}
-	~fixed_capacity() {}
+	constexpr fixed_capacity()
+	{
+		if consteval
+		{
+			if constexpr (trivial)
+				for (auto& element : m_elements.elements)
+					std::construct_at(std::addressof(element));
+		}
+	}
+	constexpr fixed_capacity(size_t cap) : fixed_capacity() {}
+	constexpr ~fixed_capacity() {}
 
 	constexpr static size_t capacity() { return CAP; }
 
-	value_type* capacity_begin() { return elements; }
-	value_type* capacity_end() { return elements + CAP; }
-	const value_type* capacity_begin() const { return elements; }
-	const value_type* capacity_end() const { return elements + CAP; }
+	constexpr value_type* capacity_begin() { return m_elements.elements; }
+	constexpr value_type* capacity_end() { return m_elements.elements + CAP; }
+	constexpr const value_type* capacity_begin() const { return m_elements.elements; }
+	constexpr const value_type* capacity_end() const { return m_elements.elements + CAP; }
 
 private:
 
-	union
+	// Trivial elements are held in a plain array, so that the capacity can be used in constant expressions. (It
+	// is value initialized in constant evaluation, since a constant cannot hold indeterminate values.) Other
+	// elements are held in a union, so that they are not constructed or destroyed with the capacity.
+
+	struct trivial_elements
+	{
+		alignas(ALIGN) value_type elements[CAP];
+	};
+	union union_elements
 	{
-		value_type elements[CAP];
+		constexpr union_elements() {}
+		constexpr ~union_elements() {}
+
+		alignas(ALIGN) value_type elements[CAP];
 		unsigned char unused;
 	};
+
+	std::conditional_t<trivial, trivial_elements, union_elements> m_elements;
 };
 
 
@@ -48,14 +72,14 @@ class fixed_sequence_storage
 };
 
 template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage<sequence_location_lits::FRONT, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+class fixed_sequence_storage<sequence_location_lits::FRONT, T, TRAITS> : fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>
 {
 	using value_type = T;
 	using iterator = value_type*;
 	using const_iterator = const value_type*;
 	using reference = value_type&;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
+	using size_type = fixed_size_type<TRAITS>;
+	using inherited = fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>;
 
 public:
 
@@ -64,58 +88,59 @@ public:
 	using inherited::capacity_end;
 
 	fixed_sequence_storage() = default;
-	fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	constexpr fixed_sequence_storage(const fixed_sequence_storage& rhs)
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		copy_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
 		m_size = rhs.m_size;
 	}
-	fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage(fixed_sequence_storage&& rhs)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
 		m_size = rhs.m_size;
 	}
-	fixed_sequence_storage(std::initializer_list<value_type> il)
+	constexpr fixed_sequence_storage(std::initializer_list<value_type> il)
 	{
 		assert(il.size() <= capacity());
 
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
+		copy_data(il.begin(), il.end(), capacity_begin());
 		m_size = static_cast<size_type>(il.size());
 	}
 	template<sequence_storage_implementation SEQ>
-	fixed_sequence_storage(SEQ&& rhs)
+	constexpr fixed_sequence_storage(SEQ&& rhs)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
 		m_size = static_cast<size_type>(rhs.size());
 	}
 
-	~fixed_sequence_storage()
+	constexpr ~fixed_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	// Copy assignment assigns over the existing elements, constructing or destroying only the difference (see
+	// assign_elements).
+
+	constexpr fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin());
-		m_size = rhs.m_size;
+		assign_elements<sequence_location_lits::FRONT>(*this, rhs);
 		return *this;
 	}
-	fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
 	{
 		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
 		m_size = rhs.m_size;
 		return *this;
 	}
 
-	value_type* data_begin() { return capacity_begin(); }
-	value_type* data_end() { return capacity_begin() + m_size; }
-	const value_type* data_begin() const { return capacity_begin(); }
-	const value_type* data_end() const { return capacity_begin() + m_size; }
-	size_t size() const { return m_size; }
+	constexpr value_type* data_begin() { return capacity_begin(); }
+	constexpr value_type* data_end() { return capacity_begin() + m_size; }
+	constexpr const value_type* data_begin() const { return capacity_begin(); }
+	constexpr const value_type* data_end() const { return capacity_begin() + m_size; }
+	constexpr size_t size() const { return m_size; }
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
@@ -123,51 +148,66 @@ public:
 		if (size() == 0 || pos == data_end())
 			add_back(std::forward<ARGS>(args)...);
 		else
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
 			pos = back_add_at(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
+		return back_add_range_at(data_end(), pos, first, count,
+								 [this](size_t n){ m_size += static_cast<size_type>(n); });
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		add_at(data_begin(), std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		assert(size() < capacity());
 
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
+		std::construct_at(data_end(), std::forward<ARGS>(args)...);
 		++m_size;
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		construct_data(data_end(), count, std::forward<ARGS>(args)...);
+		m_size += static_cast<size_type>(count);
 	}
 
-	void clear()
+	constexpr void clear()
 	{
 		auto end = data_end();
 		m_size = 0;
 		destroy_data(data_begin(), end);
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		back_erase(data_begin(), data_end(), erase_begin, erase_end,
 				   [this](size_t count){ m_size -= static_cast<size_type>(count); });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		back_erase(data_begin(), data_end(), element, [this](){ --m_size; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
 		erase(data_begin());
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -181,12 +221,12 @@ private:
 };
 
 template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+class fixed_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
+	using size_type = fixed_size_type<TRAITS>;
+	using inherited = fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>;
 
 public:
 
@@ -195,103 +235,120 @@ public:
 	using inherited::capacity_end;
 
 	fixed_sequence_storage() = default;
-	fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	constexpr fixed_sequence_storage(const fixed_sequence_storage& rhs)
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		copy_data(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
 		m_size = rhs.m_size;
 	}
-	fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage(fixed_sequence_storage&& rhs)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
 		m_size = rhs.m_size;
 	}
-	fixed_sequence_storage(std::initializer_list<value_type> il)
+	constexpr fixed_sequence_storage(std::initializer_list<value_type> il)
 	{
 		assert(il.size() <= capacity());
 
-		std::uninitialized_copy(il.begin(), il.end(), capacity_end() - il.size());
+		copy_data(il.begin(), il.end(), capacity_end() - il.size());
 		m_size = static_cast<size_type>(il.size());
 	}
 	template<sequence_storage_implementation SEQ>
-	fixed_sequence_storage(SEQ&& rhs)
+	constexpr fixed_sequence_storage(SEQ&& rhs)
 	{
 		m_size = static_cast<size_type>(rhs.size());
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - m_size);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_end() - m_size);
 	}
-	~fixed_sequence_storage()
+	constexpr ~fixed_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	constexpr fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
-		m_size = rhs.m_size;
+		assign_elements<sequence_location_lits::BACK>(*this, rhs);
 		return *this;
 	}
-	fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
 	{
 		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
 		m_size = rhs.m_size;
 		return *this;
 	}
 
-	value_type* data_begin() { return capacity_end() - m_size; }
-	value_type* data_end() { return capacity_end(); }
-	const value_type* data_begin() const { return capacity_end() - m_size; }
-	const value_type* data_end() const { return capacity_end(); }
-	size_t size() const { return m_size; }
+	constexpr value_type* data_begin() { return capacity_end() - m_size; }
+	constexpr value_type* data_end() { return capacity_end(); }
+	constexpr const value_type* data_begin() const { return capacity_end() - m_size; }
+	constexpr const value_type* data_end() const { return capacity_end(); }
+	constexpr size_t size() const { return m_size; }
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
 
 		if (m_size == 0 || pos == data_begin())
+		{
 			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
 		else
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
 			pos = front_add_at(data_begin(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
+		return front_add_range_at(data_begin(), pos, first, count,
+								  [this](size_t n){ m_size += static_cast<size_type>(n); });
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		assert(size() < capacity());
 
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		std::construct_at(data_begin() - 1, std::forward<ARGS>(args)...);
 		++m_size;
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		add_at(data_end(), std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		while (count--)
-			add_front(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size());
+		front_add_n(data_begin(), data_end(), count, [this](size_t n){ m_size += static_cast<size_type>(n); },
+					std::forward<ARGS>(args)...);
 	}
 
-	void clear()
+	constexpr void clear()
 	{
 		auto begin = data_begin();
 		m_size = 0;
 		destroy_data(begin, data_end());
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		front_erase(data_begin(), data_end(), erase_begin, erase_end,
 					[this](size_t count){ m_size -= static_cast<size_type>(count); });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		front_erase(data_begin(), data_end(), element, [this](){ --m_size; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
@@ -299,7 +356,7 @@ public:
 		--m_size;
 		dst->~value_type();
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -312,12 +369,12 @@ private:
 };
 
 template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+class fixed_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
+	using size_type = fixed_size_type<TRAITS>;
+	using inherited = fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>;
 
 public:
 
@@ -326,134 +383,199 @@ public:
 	using inherited::capacity_end;
 
 	fixed_sequence_storage() = default;
-	fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	constexpr fixed_sequence_storage(const fixed_sequence_storage& rhs)
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		copy_data(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
 		m_front_gap = rhs.m_front_gap;
 		m_back_gap = rhs.m_back_gap;
 	}
-	fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage(fixed_sequence_storage&& rhs)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
 		m_front_gap = rhs.m_front_gap;
 		m_back_gap = rhs.m_back_gap;
 	}
-	fixed_sequence_storage(std::initializer_list<value_type> il)
+	constexpr fixed_sequence_storage(std::initializer_list<value_type> il)
 	{
 		assert(il.size() <= capacity());
 
-		auto offset = TRAITS.front_gap(il.size());
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin() + offset);
+		auto offset = aligned_front_gap<T, TRAITS>(TRAITS.capacity, il.size());
+		copy_data(il.begin(), il.end(), capacity_begin() + offset);
 		m_front_gap = static_cast<size_type>(offset);
 		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + il.size()));
 	}
 	template<sequence_storage_implementation SEQ>
-	fixed_sequence_storage(SEQ&& rhs)
+	constexpr fixed_sequence_storage(SEQ&& rhs)
 	{
 		auto size = rhs.size();
-		auto offset = TRAITS.front_gap(size);
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + offset);
+		auto offset = aligned_front_gap<T, TRAITS>(TRAITS.capacity, size);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin() + offset);
 		m_front_gap = static_cast<size_type>(offset);
 		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + size));
 	}
-	~fixed_sequence_storage()
+	constexpr ~fixed_sequence_storage()
 	{
 		destroy_data(data_begin(), data_end());
 	}
 
-	fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	constexpr fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
-		m_front_gap = rhs.m_front_gap;
-		m_back_gap = rhs.m_back_gap;
+		assign_elements<sequence_location_lits::MIDDLE>(*this, rhs);
 		return *this;
 	}
-	fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	constexpr fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
 	{
 		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
 		m_front_gap = rhs.m_front_gap;
 		m_back_gap = rhs.m_back_gap;
 		return *this;
 	}
 
-	value_type* data_begin() { return capacity_begin() + m_front_gap; }
-	value_type* data_end() { return capacity_end() - m_back_gap; }
-	const value_type* data_begin() const { return capacity_begin() + m_front_gap; }
-	const value_type* data_end() const { return capacity_end() - m_back_gap; }
-	size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
+	constexpr value_type* data_begin() { return capacity_begin() + m_front_gap; }
+	constexpr value_type* data_end() { return capacity_end() - m_back_gap; }
+	constexpr const value_type* data_begin() const { return capacity_begin() + m_front_gap; }
+	constexpr const value_type* data_end() const { return capacity_end() - m_back_gap; }
+	constexpr size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(pos >= data_begin() && pos <= data_end());
 
 		if (size() == 0 || pos == data_end())
+		{
 			add_back(std::forward<ARGS>(args)...);
+			pos = data_end() - 1;
+		}
 		else if (pos == data_begin())
+		{
 			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
 		else if (pos - data_begin() >= data_end() - pos)			// Inserting closer to the end--add at back.
 		{
 			if (m_back_gap == 0)
 			{
-				recenter();
+				if (!constructible_in_gap(data_begin(), data_end(), args...))
+					return add_at(pos, value_type(std::forward<ARGS>(args)...));
+				recenter(false);
 				pos -= m_back_gap;
 			}
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
 			pos = back_add_at(data_end(), pos, [this](){ --m_back_gap; }, std::forward<ARGS>(args)...);
 		}
 		else										// Inserting closer to the beginning--add at front.
 		{
 			if (m_front_gap == 0)
 			{
-				recenter();
+				if (!constructible_in_gap(data_begin(), data_end(), args...))
+					return add_at(pos, value_type(std::forward<ARGS>(args)...));
+				recenter(true);
 				pos += m_front_gap;
 			}
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
 			pos = front_add_at(data_begin(), pos, [this](){ --m_front_gap; }, std::forward<ARGS>(args)...);
 		}
 		return pos;
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		// The gap is opened at the nearer end if there is room there, otherwise at the other end if there is
+		// room there. If neither end has room, the elements are first repositioned to make room at the nearer end.
+		bool at_back = pos - data_begin() >= data_end() - pos;
+		if ((at_back ? m_back_gap : m_front_gap) < count)
+		{
+			if ((at_back ? m_front_gap : m_back_gap) >= count)
+				at_back = !at_back;
+			else
+			{
+				auto index = pos - data_begin();
+				auto size = this->size();
+				auto extra = m_front_gap + m_back_gap - count;
+				auto front_gap = at_back ? extra / 2 : count + (extra - extra / 2);
+				reposition<inherited>(capacity_begin(), data_begin(), data_end(), front_gap);
+				m_front_gap = static_cast<size_type>(front_gap);
+				m_back_gap = static_cast<size_type>(capacity() - (front_gap + size));
+				pos = data_begin() + index;
+			}
+		}
+		if (at_back)
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, data_end() - pos);
+			return back_add_range_at(data_end(), pos, first, count,
+									 [this](size_t n){ m_back_gap -= static_cast<size_type>(n); });
+		}
+		else
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, pos - data_begin());
+			return front_add_range_at(data_begin(), pos, first, count,
+									  [this](size_t n){ m_front_gap -= static_cast<size_type>(n); });
+		}
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(m_front_gap || m_back_gap);
 
 		if (m_front_gap == 0)
-			recenter();
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		{
+			if (!constructible_in_gap(data_begin(), data_end(), args...))
+				return add_front(value_type(std::forward<ARGS>(args)...));
+			recenter(true);
+		}
+		std::construct_at(data_begin() - 1, std::forward<ARGS>(args)...);
 		--m_front_gap;
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		assert(size() < capacity());
 		assert(m_front_gap || m_back_gap);
 
 		if (m_back_gap == 0)
-			recenter();
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
+		{
+			if (!constructible_in_gap(data_begin(), data_end(), args...))
+				return add_back(value_type(std::forward<ARGS>(args)...));
+			recenter(false);
+		}
+		std::construct_at(data_end(), std::forward<ARGS>(args)...);
 		--m_back_gap;
 	}
 	template<typename... ARGS>
-	void add(size_t count, ARGS&&... args)
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		// This is certainly not as optimized as it could be. The question is,
-		// how useful is resize for a middle location container?
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		assert(size() + count <= capacity());
+
+		// If there is not enough room at the back, the elements are first placed for the new size.
+		if (m_back_gap < count)
+		{
+			count_event<T, TRAITS>(sequence_event::RECENTER);
+			auto size = this->size();
+			auto front_gap = aligned_front_gap<T, TRAITS>(TRAITS.capacity, size + count);
+			reposition<inherited>(capacity_begin(), data_begin(), data_end(), front_gap);
+			m_front_gap = static_cast<size_type>(front_gap);
+			m_back_gap = static_cast<size_type>(capacity() - (front_gap + size));
+		}
+		construct_data(data_end(), count, std::forward<ARGS>(args)...);
+		m_back_gap -= static_cast<size_type>(count);
 	}
 
-	void clear()
+	constexpr void clear()
 	{
 		auto begin = data_begin();
 		auto end = data_end();
-		m_front_gap = static_cast<size_type>(TRAITS.front_gap());
+		m_front_gap = static_cast<size_type>(aligned_front_gap<T, TRAITS>(TRAITS.capacity, 0));
 		m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
 		destroy_data(begin, end);
 	}
-	void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
 	{
 		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
 		if (erase_begin - data_begin() >= data_end() - erase_end)
@@ -463,7 +585,7 @@ public:
 			front_erase(data_begin(), data_end(), erase_begin, erase_end,
 						[this](size_t count){ m_front_gap += static_cast<size_type>(count); });
 	}
-	void erase(value_type* element)
+	constexpr void erase(value_type* element)
 	{
 		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
 		if (element - data_begin() >= data_end() - element)
@@ -471,7 +593,7 @@ public:
 		else
 			front_erase(data_begin(), data_end(), element, [this](){ ++m_front_gap; });
 	}
-	void pop_front()
+	constexpr void pop_front()
 	{
 		assert(size());
 
@@ -479,7 +601,7 @@ public:
 		++m_front_gap;
 		dst->~value_type();
 	}
-	void pop_back()
+	constexpr void pop_back()
 	{
 		assert(size());
 
@@ -489,18 +611,361 @@ public:
 
 private:
 
-	// This function recenters the elements to prepare for size growth. If the remaining space is odd, then the
-	// extra space will be at the front if we are making space at the front, otherwise it will be at the back.
+	// This function recenters the elements to prepare for size growth at the front (if 'at_front') or the back.
+	// The free space is divided according to the front bias (see ::recenter).
 	
-	void recenter()
+	constexpr void recenter(bool at_front)
 	{
-		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
+		count_event<T, TRAITS>(sequence_event::RECENTER);
+		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end(),
+														   at_front, TRAITS.front_bias, capacity_granule<T, TRAITS>);
 		m_front_gap = static_cast<size_type>(front_gap);
 		m_back_gap = static_cast<size_type>(back_gap);
 	}
 
 	// Empty sequences with odd capacity will have the extra space at the back.
 
-	size_type m_front_gap = static_cast<size_type>(TRAITS.front_gap());
-	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - TRAITS.front_gap());
+	size_type m_front_gap = static_cast<size_type>(aligned_front_gap<T, TRAITS>(TRAITS.capacity, 0));
+	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - aligned_front_gap<T, TRAITS>(TRAITS.capacity, 0));
+};
+
+template<typename T, sequence_traits TRAITS>
+class fixed_sequence_storage<sequence_location_lits::CIRCULAR, T, TRAITS> : fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>
+{
+	using value_type = T;
+	using iterator = circular_iterator<value_type>;
+	using const_iterator = circular_iterator<const value_type>;
+	using reference = value_type&;
+	using size_type = fixed_size_type<TRAITS>;
+	using inherited = fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	fixed_sequence_storage() = default;
+	constexpr fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	{
+		copy_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		m_size = rhs.m_size;
+	}
+	constexpr fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	{
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		m_size = rhs.m_size;
+	}
+	constexpr fixed_sequence_storage(std::initializer_list<value_type> il)
+	{
+		assert(il.size() <= capacity());
+
+		copy_data(il.begin(), il.end(), capacity_begin());
+		m_size = static_cast<size_type>(il.size());
+	}
+
+	constexpr ~fixed_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	constexpr fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	{
+		assign_elements<sequence_location_lits::CIRCULAR>(*this, rhs);
+		return *this;
+	}
+	constexpr fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	{
+		clear();
+		move_data(rhs.data_begin(), rhs.data_end(), capacity_begin());
+		m_size = rhs.m_size;
+		return *this;
+	}
+
+	constexpr iterator data_begin() { return iterator(capacity_begin(), capacity(), m_head, 0); }
+	constexpr iterator data_end() { return iterator(capacity_begin(), capacity(), m_head, m_size); }
+	constexpr const_iterator data_begin() const { return const_iterator(capacity_begin(), capacity(), m_head, 0); }
+	constexpr const_iterator data_end() const { return const_iterator(capacity_begin(), capacity(), m_head, m_size); }
+	constexpr size_t size() const { return m_size; }
+
+	// Insertions and erasures move the elements on the nearer side of the position, wrapping around the end of
+	// the capacity as needed. (Adding or removing at either end moves nothing.)
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		size_t index = pos - data_begin();
+		if (index == size())
+			add_back(std::forward<ARGS>(args)...);
+		else if (index == 0)
+			add_front(std::forward<ARGS>(args)...);
+		else
+		{
+			value_type temp(std::forward<ARGS>(args)...);
+			if (index >= size() - index)
+			{
+				count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size() - index);
+				auto end = data_end();
+				std::construct_at(end.address(), std::move(*(end - 1)));
+				++m_size;
+				std::move_backward(data_begin() + index, end - 1, end);
+			}
+			else
+			{
+				count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, index);
+				std::construct_at(address(capacity() - 1), std::move(*data_begin()));
+				m_head = static_cast<size_type>(offset(capacity() - 1));
+				++m_size;
+				std::move(data_begin() + 2, data_begin() + index + 1, data_begin() + 1);
+			}
+			data_begin()[index] = std::move(temp);
+		}
+		return data_begin() + index;
+	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		assert(size() + count <= capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		// The new elements are constructed at the nearer end and rotated into place.
+
+		size_t index = pos - data_begin();
+		size_t old_size = size();
+		size_t constructed = 0;
+		bool at_front = index < size() - index;
+		try
+		{
+			if (at_front)
+			{
+				count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, index);
+				size_t head = offset(capacity() - count);
+				for (; constructed != count; ++constructed, ++first)
+					std::construct_at(capacity_begin() + offset(capacity() - count + constructed), *first);
+				m_head = static_cast<size_type>(head);
+				m_size += static_cast<size_type>(count);
+				std::rotate(data_begin(), data_begin() + count, data_begin() + count + index);
+			}
+			else
+			{
+				count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, old_size - index);
+				for (; constructed != count; ++constructed, ++first)
+					std::construct_at(address(old_size + constructed), *first);
+				m_size += static_cast<size_type>(count);
+				std::rotate(data_begin() + index, data_begin() + old_size, data_end());
+			}
+		}
+		catch (...)
+		{
+			if (constructed != count)
+			{
+				for (size_t i = 0; i != constructed; ++i)
+					address(at_front ? capacity() - count + i : old_size + i)->~value_type();
+			}
+			throw;
+		}
+		return data_begin() + index;
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		std::construct_at(address(capacity() - 1), std::forward<ARGS>(args)...);
+		m_head = static_cast<size_type>(offset(capacity() - 1));
+		++m_size;
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		std::construct_at(data_end().address(), std::forward<ARGS>(args)...);
+		++m_size;
+	}
+	template<typename... ARGS>
+	constexpr void add(size_t count, ARGS&&... args)
+	{
+		assert(size() + count <= capacity());
+
+		// The new elements may wrap around the end of the capacity, so they are constructed in two parts.
+
+		auto dst = address(size());
+		size_t first = std::min<size_t>(count, capacity_end() - dst);
+		construct_data(dst, first, args...);
+		try
+		{
+			construct_data(capacity_begin(), count - first, args...);
+		}
+		catch (...)
+		{
+			destroy_data(dst, dst + first);
+			throw;
+		}
+		m_size += static_cast<size_type>(count);
+	}
+
+	constexpr void clear()
+	{
+		auto begin = data_begin();
+		auto end = data_end();
+		m_head = 0;
+		m_size = 0;
+		destroy_data(begin, end);
+	}
+	constexpr void erase(iterator erase_begin, iterator erase_end)
+	{
+		assert(erase_begin >= data_begin() && erase_end <= data_end());
+
+		size_t count = erase_end - erase_begin;
+		if (count == 0)
+			return;
+
+		auto begin = data_begin();
+		auto end = data_end();
+		if (erase_begin - begin < end - erase_end)
+		{
+			std::move_backward(begin, erase_begin, erase_end);
+			m_head = static_cast<size_type>(offset(count));
+			m_size -= static_cast<size_type>(count);
+			destroy_data(begin, begin + count);
+		}
+		else
+		{
+			std::move(erase_end, end, erase_begin);
+			m_size -= static_cast<size_type>(count);
+			destroy_data(end - count, end);
+		}
+	}
+	constexpr void erase(iterator element)
+	{
+		erase(element, element + 1);
+	}
+	constexpr void pop_front()
+	{
+		assert(size());
+
+		auto element = address(0);
+		m_head = static_cast<size_type>(offset(1));
+		--m_size;
+		element->~value_type();
+	}
+	constexpr void pop_back()
+	{
+		assert(size());
+
+		--m_size;
+		address(size())->~value_type();
+	}
+
+	// The linearize function moves the elements (if needed) so that they start at the beginning of the
+	// capacity and returns a pointer to them. The two parts are swapped in place when the elements are
+	// move assignable. Otherwise they are moved out to a temporary capacity and back again.
+
+	constexpr value_type* linearize()
+	{
+		size_t first = std::min<size_t>(size(), capacity() - m_head);
+		size_t second = size() - first;
+
+		if (second == 0)
+			reposition<inherited>(capacity_begin(), capacity_begin() + m_head, capacity_begin() + m_head + first, 0);
+		else if constexpr (std::is_move_assignable_v<T> && std::is_swappable_v<T>)
+		{
+			reposition<inherited>(capacity_begin(), capacity_begin() + m_head, capacity_end(), second);
+			std::rotate(capacity_begin(), capacity_begin() + second, capacity_begin() + size());
+		}
+		else
+		{
+			inherited temp;
+			relocate(capacity_begin() + m_head, capacity_end(), temp.capacity_begin());
+			relocate(capacity_begin(), capacity_begin() + second, temp.capacity_begin() + first);
+			relocate(temp.capacity_begin(), temp.capacity_begin() + size(), capacity_begin());
+		}
+		m_head = 0;
+		return capacity_begin();
+	}
+
+	// The segments function returns the elements as two contiguous parts. The second part is empty
+	// unless the elements wrap around the end of the capacity.
+
+	constexpr std::pair<std::span<value_type>, std::span<value_type>> segments()
+	{
+		size_t first = std::min<size_t>(size(), capacity() - m_head);
+		return {std::span(capacity_begin() + m_head, first), std::span(capacity_begin(), size() - first)};
+	}
+	constexpr std::pair<std::span<const value_type>, std::span<const value_type>> segments() const
+	{
+		size_t first = std::min<size_t>(size(), capacity() - m_head);
+		return {std::span(capacity_begin() + m_head, first), std::span(capacity_begin(), size() - first)};
+	}
+
+private:
+
+	// The offset function maps an index relative to the first element onto the capacity. The index must be
+	// less than twice the capacity, so capacity() - n is used for the nth place in front of the first element.
+
+	constexpr size_t offset(size_t index) const
+	{
+		size_t offset = m_head + index;
+		return offset < capacity() ? offset : offset - capacity();
+	}
+	constexpr value_type* address(size_t index)
+	{
+		return capacity_begin() + offset(index);
+	}
+
+	size_type m_head = 0;
+	size_type m_size = 0;
 };
+
+// swap_fixed_storage - Exchanges the elements of two fixed storages, whose capacities cannot change hands (STATIC
+// storage). Small storages of trivially relocatable elements are exchanged as bytes, capacity and all, which is a
+// few vector operations. Otherwise the elements at the same positions are swapped and the extra elements of the
+// larger sequence are moved to the end of the smaller one, so this is min(n, m) swaps and |n - m| moves, with no
+// temporary. (For BACK location the positions are counted from the back, and the extra elements are moved to the
+// front of the smaller sequence, where its room is.)
+
+template<sequence_location_lits LOC, typename T, sequence_traits TRAITS>
+constexpr void swap_fixed_storage(fixed_sequence_storage<LOC, T, TRAITS>& lhs, fixed_sequence_storage<LOC, T, TRAITS>& rhs)
+{
+	constexpr size_t byte_swap_limit = 256;
+
+	if (&lhs == &rhs)
+		return;
+	if constexpr (sequence_trivially_relocatable<T> && sizeof(lhs) <= byte_swap_limit)
+		if !consteval
+		{
+			auto lhs_bytes = reinterpret_cast<unsigned char*>(&lhs);
+			std::swap_ranges(lhs_bytes, lhs_bytes + sizeof(lhs), reinterpret_cast<unsigned char*>(&rhs));
+			return;
+		}
+
+	bool lhs_smaller = lhs.size() < rhs.size();
+	auto& smaller = lhs_smaller ? lhs : rhs;
+	auto& larger = lhs_smaller ? rhs : lhs;
+	size_t common = smaller.size();
+	size_t extra = larger.size() - common;
+
+	if constexpr (LOC == sequence_location_lits::BACK)
+	{
+		std::swap_ranges(smaller.data_begin(), smaller.data_end(), larger.data_begin() + extra);
+		if (extra)
+		{
+			smaller.add_range_at(smaller.data_begin(), std::make_move_iterator(larger.data_begin()), extra);
+			larger.erase(larger.data_begin(), larger.data_begin() + extra);
+		}
+	}
+	else
+	{
+		std::swap_ranges(smaller.data_begin(), smaller.data_end(), larger.data_begin());
+		if (extra)
+		{
+			auto tail = larger.data_begin() + common;
+			smaller.add_range_at(smaller.data_end(), std::make_move_iterator(tail), extra);
+			larger.erase(tail, larger.data_end());
+		}
+	}
+}
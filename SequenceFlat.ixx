@@ -0,0 +1,457 @@
+export module sequence:flat;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// Flat associative containers. These keep their elements sorted (and unique) in a sequence, so lookup is a binary
+// search of contiguous data. Insertion and erasure shift the elements on one side of the position, so MIDDLE
+// location (which shifts the nearer end) halves the average cost. The container is a sequence, whose traits are
+// exposed, so for instance BUFFERED storage may be used for small sets and maps.
+
+// sequence_sorted_unique - Tag indicating that the elements passed to a constructor or insert function are already
+// sorted and unique, so that they need not be sorted.
+
+export struct sequence_sorted_unique_t { explicit sequence_sorted_unique_t() = default; };
+export inline constexpr sequence_sorted_unique_t sequence_sorted_unique{};
+
+// The key functions return the key of an element for the set and the map.
+
+struct flat_set_key
+{
+	template<typename T>
+	const T& operator()(const T& element) const { return element; }
+};
+
+struct flat_map_key
+{
+	template<typename T>
+	const auto& operator()(const T& element) const { return element.first; }
+};
+
+// ==============================================================================================================
+// flat_base - Base class for the flat containers. The elements are kept sorted by the keys returned by KEY_OF and
+// are unique. Lookup functions with other key types are available if the comparator is transparent. If MUTABLE,
+// the iterators allow the elements to be modified (but not in a way which changes their order).
+
+template<typename CONTAINER, typename COMPARE, typename KEY_OF, bool MUTABLE>
+class flat_base
+{
+	static constexpr bool transparent = requires { typename COMPARE::is_transparent; };
+
+public:
+
+	using container_type = CONTAINER;
+	using value_type = typename container_type::value_type;
+	using key_type = std::remove_cvref_t<std::invoke_result_t<KEY_OF, const value_type&>>;
+	using key_compare = COMPARE;
+	using allocator_type = typename container_type::allocator_type;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = std::conditional_t<MUTABLE, value_type&, const value_type&>;
+	using const_reference = const value_type&;
+	using iterator = std::conditional_t<MUTABLE, typename container_type::iterator, typename container_type::const_iterator>;
+	using const_iterator = typename container_type::const_iterator;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	using traits_type = typename container_type::traits_type;
+	static constexpr traits_type traits = container_type::traits;
+
+	// value_compare - Compares elements by their keys.
+
+	class value_compare
+	{
+	public:
+
+		bool operator()(const value_type& lhs, const value_type& rhs) const
+		{
+			return m_compare(KEY_OF()(lhs), KEY_OF()(rhs));
+		}
+
+	private:
+
+		friend flat_base;
+		explicit value_compare(const key_compare& compare) : m_compare(compare) {}
+
+		key_compare m_compare;
+	};
+
+	flat_base() = default;
+	explicit flat_base(const key_compare& compare) : m_compare(compare) {}
+	explicit flat_base(container_type elements, const key_compare& compare = key_compare()) :
+		m_elements(std::move(elements)), m_compare(compare)
+	{
+		std::stable_sort(m_elements.begin(), m_elements.end(), value_comp());
+		merge_unique(0);
+	}
+	flat_base(sequence_sorted_unique_t, container_type elements, const key_compare& compare = key_compare()) :
+		m_elements(std::move(elements)), m_compare(compare)
+	{
+		assert(std::ranges::adjacent_find(m_elements, std::not_fn(value_comp())) == m_elements.end());
+	}
+	template<std::input_iterator ITER>
+	flat_base(ITER first, ITER last, const key_compare& compare = key_compare()) : m_compare(compare)
+	{
+		insert(first, last);
+	}
+	template<std::input_iterator ITER>
+	flat_base(sequence_sorted_unique_t tag, ITER first, ITER last, const key_compare& compare = key_compare()) :
+		m_compare(compare)
+	{
+		insert(tag, first, last);
+	}
+	flat_base(std::initializer_list<value_type> il, const key_compare& compare = key_compare()) :
+		flat_base(il.begin(), il.end(), compare) {}
+	flat_base(sequence_sorted_unique_t tag, std::initializer_list<value_type> il, const key_compare& compare = key_compare()) :
+		flat_base(tag, il.begin(), il.end(), compare) {}
+
+	iterator				begin() { return m_elements.begin(); }
+	const_iterator			begin() const { return m_elements.begin(); }
+	iterator				end() { return m_elements.end(); }
+	const_iterator			end() const { return m_elements.end(); }
+	reverse_iterator		rbegin() { return reverse_iterator(end()); }
+	const_reverse_iterator	rbegin() const { return const_reverse_iterator(end()); }
+	reverse_iterator		rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator	rend() const { return const_reverse_iterator(begin()); }
+
+	const_iterator			cbegin() const { return begin(); }
+	const_iterator			cend() const { return end(); }
+	const_reverse_iterator	crbegin() const { return rbegin(); }
+	const_reverse_iterator	crend() const { return rend(); }
+
+	bool empty() const { return m_elements.empty(); }
+	size_type size() const { return m_elements.size(); }
+	size_type max_size() const { return m_elements.max_size(); }
+	size_type capacity() const { return m_elements.capacity(); }
+	void reserve(size_type new_capacity) { m_elements.reserve(new_capacity); }
+	void shrink_to_fit() { m_elements.shrink_to_fit(); }
+	allocator_type get_allocator() const { return m_elements.get_allocator(); }
+
+	key_compare key_comp() const { return m_compare; }
+	value_compare value_comp() const { return value_compare(m_compare); }
+
+	// The insert functions for a single element insert it if there is no element with an equivalent key. A hint
+	// which is the correct position avoids the search.
+
+	std::pair<iterator, bool> insert(const value_type& value) { return insert_unique(value); }
+	std::pair<iterator, bool> insert(value_type&& value) { return insert_unique(std::move(value)); }
+	iterator insert(const_iterator hint, const value_type& value) { return insert_hint(hint, value); }
+	iterator insert(const_iterator hint, value_type&& value) { return insert_hint(hint, std::move(value)); }
+
+	template<typename... ARGS>
+	std::pair<iterator, bool> emplace(ARGS&&... args)
+	{
+		return insert_unique(value_type(std::forward<ARGS>(args)...));
+	}
+	template<typename... ARGS>
+	iterator emplace_hint(const_iterator hint, ARGS&&... args)
+	{
+		return insert_hint(hint, value_type(std::forward<ARGS>(args)...));
+	}
+
+	// The bulk insert functions append the new elements, sort them (unless they are already sorted and unique) and
+	// merge them with the existing elements, so inserting n elements into m is O(n log n + m) rather than O(n m).
+	// If the new elements all follow the existing ones, no merge is needed. Where keys are equivalent, the element
+	// which was already present (or the first one inserted) is kept.
+
+	template<std::input_iterator ITER>
+	void insert(ITER first, ITER last)
+	{
+		auto size = m_elements.size();
+		m_elements.insert(m_elements.end(), first, last);
+		std::stable_sort(m_elements.begin() + size, m_elements.end(), value_comp());
+		merge_unique(size);
+	}
+	template<std::input_iterator ITER>
+	void insert(sequence_sorted_unique_t, ITER first, ITER last)
+	{
+		auto size = m_elements.size();
+		m_elements.insert(m_elements.end(), first, last);
+		merge_unique(size);
+	}
+	void insert(std::initializer_list<value_type> il) { insert(il.begin(), il.end()); }
+	void insert(sequence_sorted_unique_t tag, std::initializer_list<value_type> il) { insert(tag, il.begin(), il.end()); }
+	template<std::ranges::input_range RANGE>
+	void insert_range(RANGE&& range)
+	{
+		auto size = m_elements.size();
+		m_elements.append_range(std::forward<RANGE>(range));
+		std::stable_sort(m_elements.begin() + size, m_elements.end(), value_comp());
+		merge_unique(size);
+	}
+
+	iterator erase(const_iterator pos)
+	{
+		auto index = pos - cbegin();
+		m_elements.erase(m_elements.begin() + index);
+		return begin() + index;
+	}
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		auto index = first - cbegin();
+		m_elements.erase(m_elements.begin() + index, m_elements.begin() + (last - cbegin()));
+		return begin() + index;
+	}
+	size_type erase(const key_type& key) { return erase_key(key); }
+	template<typename K> requires (transparent && !std::convertible_to<K, const_iterator>)
+	size_type erase(K&& key) { return erase_key(key); }
+
+	void clear() { m_elements.clear(); }
+	void swap(flat_base& rhs)
+	{
+		m_elements.swap(rhs.m_elements);
+		std::swap(m_compare, rhs.m_compare);
+	}
+
+	// The extract function moves the elements out and the replace function moves them in. The replacement elements
+	// must be sorted and unique.
+
+	container_type extract() &&
+	{
+		return std::move(m_elements);
+	}
+	void replace(container_type&& elements)
+	{
+		m_elements = std::move(elements);
+	}
+
+	// The lookup functions search the contiguous elements by binary search.
+
+	iterator find(const key_type& key) { return to_iterator(find_key(key)); }
+	const_iterator find(const key_type& key) const { return find_key(key); }
+	template<typename K> requires transparent iterator find(const K& key) { return to_iterator(find_key(key)); }
+	template<typename K> requires transparent const_iterator find(const K& key) const { return find_key(key); }
+
+	bool contains(const key_type& key) const { return find_key(key) != cend(); }
+	template<typename K> requires transparent bool contains(const K& key) const { return find_key(key) != cend(); }
+
+	size_type count(const key_type& key) const { return contains(key); }
+	template<typename K> requires transparent size_type count(const K& key) const { return contains(key); }
+
+	iterator lower_bound(const key_type& key) { return to_iterator(lower_bound_key(key)); }
+	const_iterator lower_bound(const key_type& key) const { return lower_bound_key(key); }
+	template<typename K> requires transparent iterator lower_bound(const K& key) { return to_iterator(lower_bound_key(key)); }
+	template<typename K> requires transparent const_iterator lower_bound(const K& key) const { return lower_bound_key(key); }
+
+	iterator upper_bound(const key_type& key) { return to_iterator(upper_bound_key(key)); }
+	const_iterator upper_bound(const key_type& key) const { return upper_bound_key(key); }
+	template<typename K> requires transparent iterator upper_bound(const K& key) { return to_iterator(upper_bound_key(key)); }
+	template<typename K> requires transparent const_iterator upper_bound(const K& key) const { return upper_bound_key(key); }
+
+	std::pair<iterator, iterator> equal_range(const key_type& key) { return to_iterators(equal_range_key(key)); }
+	std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const { return equal_range_key(key); }
+	template<typename K> requires transparent
+	std::pair<iterator, iterator> equal_range(const K& key) { return to_iterators(equal_range_key(key)); }
+	template<typename K> requires transparent
+	std::pair<const_iterator, const_iterator> equal_range(const K& key) const { return equal_range_key(key); }
+
+	// The erase_if function erases the elements which satisfy the predicate in one pass and returns the number erased.
+
+	template<typename PRED>
+	friend size_type erase_if(flat_base& container, PRED pred)
+	{
+		auto& elements = container.m_elements;
+		auto end = elements.end();
+		auto new_end = std::remove_if(elements.begin(), end, [&](const value_type& e){ return pred(e); });
+		size_type count = end - new_end;
+		elements.erase(new_end, end);
+		return count;
+	}
+
+	friend bool operator==(const flat_base& lhs, const flat_base& rhs)
+	{
+		return std::ranges::equal(lhs.m_elements, rhs.m_elements);
+	}
+	friend auto operator<=>(const flat_base& lhs, const flat_base& rhs) requires std::three_way_comparable<value_type>
+	{
+		return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+	}
+
+protected:
+
+	// The insert_unique function inserts an element at its position if there is no element with an equivalent key.
+	// The insert_hint function inserts it at the hint if that is its position.
+
+	template<typename V>
+	std::pair<iterator, bool> insert_unique(V&& value)
+	{
+		auto pos = lower_bound_key(KEY_OF()(value));
+		if (pos != cend() && !m_compare(KEY_OF()(value), KEY_OF()(*pos)))
+			return {to_iterator(pos), false};
+		return {m_elements.emplace(pos, std::forward<V>(value)), true};
+	}
+	template<typename V>
+	iterator insert_hint(const_iterator hint, V&& value)
+	{
+		if ((hint == cbegin() || m_compare(KEY_OF()(*(hint - 1)), KEY_OF()(value))) &&
+			(hint == cend() || m_compare(KEY_OF()(value), KEY_OF()(*hint))))
+			return m_elements.emplace(hint, std::forward<V>(value));
+		return insert_unique(std::forward<V>(value)).first;
+	}
+
+	template<typename K>
+	const_iterator lower_bound_key(const K& key) const
+	{
+		return std::partition_point(cbegin(), cend(), [&](const value_type& e){ return m_compare(KEY_OF()(e), key); });
+	}
+	template<typename K>
+	const_iterator upper_bound_key(const K& key) const
+	{
+		return std::partition_point(cbegin(), cend(), [&](const value_type& e){ return !m_compare(key, KEY_OF()(e)); });
+	}
+	template<typename K>
+	std::pair<const_iterator, const_iterator> equal_range_key(const K& key) const
+	{
+		auto first = lower_bound_key(key);
+		auto last = first;
+		if (last != cend() && !m_compare(key, KEY_OF()(*last)))
+			++last;
+		return {first, last};
+	}
+	template<typename K>
+	const_iterator find_key(const K& key) const
+	{
+		auto pos = lower_bound_key(key);
+		return pos != cend() && !m_compare(key, KEY_OF()(*pos)) ? pos : cend();
+	}
+	template<typename K>
+	size_type erase_key(const K& key)
+	{
+		auto [first, last] = equal_range_key(key);
+		size_type count = last - first;
+		erase(first, last);
+		return count;
+	}
+
+	iterator to_iterator(const_iterator pos) { return begin() + (pos - cbegin()); }
+	std::pair<iterator, iterator> to_iterators(std::pair<const_iterator, const_iterator> range)
+	{
+		return {to_iterator(range.first), to_iterator(range.second)};
+	}
+
+	container_type m_elements;
+	[[no_unique_address]] key_compare m_compare;
+
+private:
+
+	// The merge_unique function merges the sorted elements after the first 'size' with those before them and erases
+	// the elements with keys equivalent to the preceding ones. Only the new elements need to be checked if no merge
+	// is needed.
+
+	void merge_unique(size_t size)
+	{
+		auto begin = m_elements.begin();
+		auto middle = begin + size;
+		auto end = m_elements.end();
+		auto compare = value_comp();
+
+		if (middle == end)
+			return;
+		auto first = middle == begin ? begin : middle - 1;
+		if (middle != begin && !compare(*(middle - 1), *middle))
+		{
+			std::inplace_merge(begin, middle, end, compare);
+			first = begin;
+		}
+		m_elements.erase(std::unique(first, end, [&](const value_type& lhs, const value_type& rhs){ return !compare(lhs, rhs); }),
+						 end);
+	}
+};
+
+// ==============================================================================================================
+// flat_set - A sorted set of unique keys in a sequence (see sequence_flat_set). The elements cannot be modified
+// through the iterators.
+
+template<typename CONTAINER, typename COMPARE>
+class flat_set : public flat_base<CONTAINER, COMPARE, flat_set_key, false>
+{
+	using inherited = flat_base<CONTAINER, COMPARE, flat_set_key, false>;
+
+public:
+
+	using inherited::inherited;
+};
+
+// ==============================================================================================================
+// flat_map - A sorted map of unique keys to values in a sequence of pairs (see sequence_flat_map). Keeping the
+// keys and values together means one allocation and one shift per insertion. The values can be modified through
+// the iterators, but the keys must not be.
+
+template<typename CONTAINER, typename COMPARE>
+class flat_map : public flat_base<CONTAINER, COMPARE, flat_map_key, true>
+{
+	using inherited = flat_base<CONTAINER, COMPARE, flat_map_key, true>;
+
+public:
+
+	using typename inherited::key_type;
+	using typename inherited::value_type;
+	using typename inherited::iterator;
+	using typename inherited::const_iterator;
+	using mapped_type = typename value_type::second_type;
+
+	using inherited::inherited;
+
+	mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+	mapped_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+
+	mapped_type& at(const key_type& key)
+	{
+		auto pos = this->find(key);
+		if (pos == this->end()) throw std::out_of_range(OUT_OF_RANGE_ERROR);
+		return pos->second;
+	}
+	const mapped_type& at(const key_type& key) const
+	{
+		auto pos = this->find(key);
+		if (pos == this->end()) throw std::out_of_range(OUT_OF_RANGE_ERROR);
+		return pos->second;
+	}
+
+	// The try_emplace functions construct the value from 'args' only if there is no element with the key.
+	// The insert_or_assign functions assign the value if there is.
+
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(const key_type& key, ARGS&&... args)
+	{
+		return try_emplace_key(key, std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(key_type&& key, ARGS&&... args)
+	{
+		return try_emplace_key(std::move(key), std::forward<ARGS>(args)...);
+	}
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& obj)
+	{
+		return insert_or_assign_key(key, std::forward<M>(obj));
+	}
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& obj)
+	{
+		return insert_or_assign_key(std::move(key), std::forward<M>(obj));
+	}
+
+private:
+
+	template<typename K, typename... ARGS>
+	std::pair<iterator, bool> try_emplace_key(K&& key, ARGS&&... args)
+	{
+		auto pos = this->lower_bound_key(key);
+		if (pos != this->cend() && !this->m_compare(key, pos->first))
+			return {this->to_iterator(pos), false};
+		return {this->m_elements.emplace(pos, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+										 std::forward_as_tuple(std::forward<ARGS>(args)...)), true};
+	}
+	template<typename K, typename M>
+	std::pair<iterator, bool> insert_or_assign_key(K&& key, M&& obj)
+	{
+		auto result = try_emplace_key(std::forward<K>(key), std::forward<M>(obj));
+		if (!result.second)
+			result.first->second = std::forward<M>(obj);
+		return result;
+	}
+
+	constexpr static auto OUT_OF_RANGE_ERROR = "invalid sequence_flat_map key";
+};
@@ -0,0 +1,256 @@
+module;
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module sequence:mapped;
+import :traits;
+
+import std;
+
+// ==============================================================================================================
+// Mapped sequences. A sequence of trivially copyable elements is saved as a header followed by its capacity, with
+// the elements at their offset within it (the gaps are written as zeros). The file can then be mapped and used in
+// place, without reading or copying the elements. The format is that of the machine which wrote the file (the
+// byte order and the element layout are not converted), so files are not portable between architectures.
+
+export enum class sequence_mapping_lits { READ_ONLY, COPY_ON_WRITE };
+
+// sequence_file_header - The header at the start of a saved sequence. The capacity starts at 'data_offset', which
+// is a multiple of the element alignment (the mapping itself is page aligned). The header has no padding
+// ('reserved' is written as zero), so equal sequences are saved as identical files.
+
+export struct sequence_file_header
+{
+	std::array<char, 8> magic;
+	std::uint32_t version;
+	std::uint32_t element_size;
+	std::uint32_t element_alignment;
+	sequence_storage_lits storage;
+	sequence_location_lits location;
+	std::uint32_t reserved;
+	std::uint64_t capacity;
+	std::uint64_t front_gap;
+	std::uint64_t size;
+	std::uint64_t data_offset;
+};
+
+static_assert(std::has_unique_object_representations_v<sequence_file_header>,
+			  "The sequence file header must not contain padding.");
+
+constexpr std::array<char, 8> SEQUENCE_FILE_MAGIC = {'S', 'E', 'Q', 'U', 'E', 'N', 'C', 'E'};
+constexpr std::uint32_t SEQUENCE_FILE_VERSION = 1;
+
+template<typename T>
+constexpr size_t sequence_data_offset()
+{
+	return (sizeof(sequence_file_header) + alignof(T) - 1) / alignof(T) * alignof(T);
+}
+
+// mappable_sequence - A sequence whose elements can be saved and mapped: they are trivially copyable and
+// contiguous. (A CIRCULAR location sequence must be copied to another location first.)
+
+export template<typename SEQ>
+concept mappable_sequence = std::is_trivially_copyable_v<typename SEQ::value_type> && requires(const SEQ& s)
+{
+	s.data();
+	s.size();
+	s.capacity_begin();
+	s.capacity_end();
+	SEQ::traits;
+};
+
+// The sequence_save function writes the sequence to 'path', replacing the file. It throws std::runtime_error if the
+// file cannot be written.
+
+export template<mappable_sequence SEQ>
+void sequence_save(const SEQ& s, const std::filesystem::path& path)
+{
+	using value_type = typename SEQ::value_type;
+
+	auto capacity = size_t(s.capacity_end() - s.capacity_begin());
+	auto front_gap = s.size() ? size_t(s.data() - s.capacity_begin()) : 0;
+	auto back_gap = capacity - front_gap - s.size();
+
+	sequence_file_header header{SEQUENCE_FILE_MAGIC, SEQUENCE_FILE_VERSION, sizeof(value_type), alignof(value_type),
+								SEQ::traits.storage, SEQ::traits.location, 0, capacity, front_gap, s.size(),
+								sequence_data_offset<value_type>()};
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	auto write_zeros = [&](size_t bytes)
+	{
+		static constexpr std::array<char, 4096> zeros{};
+		for (; bytes; bytes -= std::min(bytes, zeros.size()))
+			out.write(zeros.data(), std::min(bytes, zeros.size()));
+	};
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	write_zeros(header.data_offset - sizeof(header));
+	write_zeros(front_gap * sizeof(value_type));
+	out.write(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(value_type));
+	write_zeros(back_gap * sizeof(value_type));
+	out.close();
+	if (!out)
+		throw std::runtime_error(std::format("cannot write sequence file {}", path.string()));
+}
+
+// ==============================================================================================================
+// sequence_mapping - A saved sequence mapped into memory. A READ_ONLY mapping shares the pages of the file (so
+// restarting processes share one copy in the page cache) and its elements are const. A COPY_ON_WRITE mapping
+// gives the process private pages as it modifies the elements, and the modifications are not written to the file.
+// The elements never move and their number is fixed. The constructor throws std::runtime_error if the file cannot
+// be mapped or its header does not describe elements of type T which lie within the file.
+
+export template<typename T, sequence_mapping_lits MODE = sequence_mapping_lits::READ_ONLY>
+class sequence_mapping
+{
+	static_assert(std::is_trivially_copyable_v<T>,
+				  "Mapped sequences require trivially copyable types.");
+
+public:
+
+	using value_type = T;
+	using element_type = std::conditional_t<MODE == sequence_mapping_lits::READ_ONLY, const value_type, value_type>;
+	using iterator = element_type*;
+	using const_iterator = const value_type*;
+
+	explicit sequence_mapping(const std::filesystem::path& path)
+	{
+		map(path);
+		try
+		{
+			validate(path);
+		}
+		catch (...)
+		{
+			unmap();
+			throw;
+		}
+	}
+	sequence_mapping(sequence_mapping&& other) noexcept :
+		m_mapping(std::exchange(other.m_mapping, nullptr)), m_bytes(std::exchange(other.m_bytes, 0)) {}
+	sequence_mapping& operator=(sequence_mapping&& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			unmap();
+			m_mapping = std::exchange(rhs.m_mapping, nullptr);
+			m_bytes = std::exchange(rhs.m_bytes, 0);
+		}
+		return *this;
+	}
+	~sequence_mapping() { unmap(); }
+
+	const sequence_file_header& header() const { return *static_cast<const sequence_file_header*>(m_mapping); }
+
+	size_t size() const { return m_mapping ? header().size : 0; }
+	size_t capacity() const { return m_mapping ? header().capacity : 0; }
+	bool empty() const { return size() == 0; }
+
+	element_type* data() { return m_mapping ? capacity_begin() + header().front_gap : nullptr; }
+	const value_type* data() const { return m_mapping ? capacity_begin() + header().front_gap : nullptr; }
+
+	iterator begin() { return data(); }
+	iterator end() { return data() + size(); }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + size(); }
+
+	element_type& operator[](size_t index) { return data()[index]; }
+	const value_type& operator[](size_t index) const { return data()[index]; }
+
+	operator std::span<element_type>() { return {data(), size()}; }
+	operator std::span<const value_type>() const { return {data(), size()}; }
+
+private:
+
+	element_type* capacity_begin() const
+	{
+		return reinterpret_cast<element_type*>(static_cast<char*>(m_mapping) + header().data_offset);
+	}
+
+	// The map function maps the whole file, and the unmap function releases the mapping. (The file itself is not
+	// needed once it is mapped.)
+
+	void map(const std::filesystem::path& path)
+	{
+		auto error = [&]{ return std::runtime_error(std::format("cannot map sequence file {}", path.string())); };
+		constexpr bool read_only = MODE == sequence_mapping_lits::READ_ONLY;
+#if defined(_WIN32)
+		auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw error();
+		LARGE_INTEGER bytes;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &bytes) && bytes.QuadPart > 0)
+			mapping = CreateFileMappingW(file, nullptr, read_only ? PAGE_READONLY : PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			throw error();
+		m_mapping = MapViewOfFile(mapping, read_only ? FILE_MAP_READ : FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!m_mapping)
+			throw error();
+		m_bytes = size_t(bytes.QuadPart);
+#else
+		auto file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw error();
+		struct stat status;
+		void* p = MAP_FAILED;
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+			p = mmap(nullptr, size_t(status.st_size), read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+					 read_only ? MAP_SHARED : MAP_PRIVATE, file, 0);
+		close(file);
+		if (p == MAP_FAILED)
+			throw error();
+		m_mapping = p;
+		m_bytes = size_t(status.st_size);
+#endif
+	}
+	void unmap()
+	{
+		if (!m_mapping)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(m_mapping);
+#else
+		munmap(m_mapping, m_bytes);
+#endif
+		m_mapping = nullptr;
+		m_bytes = 0;
+	}
+
+	void validate(const std::filesystem::path& path) const
+	{
+		auto& h = header();
+		if (m_bytes < sizeof(sequence_file_header) || h.magic != SEQUENCE_FILE_MAGIC || h.version != SEQUENCE_FILE_VERSION ||
+			h.element_size != sizeof(value_type) || h.element_alignment != alignof(value_type) ||
+			h.data_offset % alignof(value_type) != 0 || h.data_offset > m_bytes ||
+			h.capacity > (m_bytes - h.data_offset) / sizeof(value_type) ||
+			h.front_gap > h.capacity || h.size > h.capacity - h.front_gap)
+			throw std::runtime_error(std::format("invalid sequence file {}", path.string()));
+	}
+
+	void* m_mapping = nullptr;
+	size_t m_bytes = 0;
+};
+
+// The sequence_load function returns a sequence of type SEQ holding a copy of the elements saved in 'path'. (The
+// elements are copied in one block from the mapping.)
+
+export template<mappable_sequence SEQ>
+SEQ sequence_load(const std::filesystem::path& path, const typename SEQ::allocator_type& alloc = typename SEQ::allocator_type())
+{
+	sequence_mapping<typename SEQ::value_type> mapping(path);
+	SEQ s(alloc);
+	s.assign(mapping.begin(), mapping.end());
+	return s;
+}
@@ -0,0 +1,408 @@
+export module sequence:migrating;
+import :traits;
+import :allocator;
+import :statistics;
+import :utilities;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// migrating_sequence_storage - The element management for VARIABLE storage with incremental reallocation (see
+// sequence_traits::migration_step), which keeps the data at the front like FRONT location. When an element added at
+// the back outgrows the capacity, the new capacity is allocated and the element is constructed in it, but the
+// elements stay in the old capacity. Each push_back and pop_back then moves up to 'migration_step' of them into the
+// new capacity (the one at the back may simply be destroyed), and the old capacity is deallocated when it is empty.
+// So no push_back moves more than 'migration_step' elements, as long as each migration finishes before the next
+// growth.
+//
+// During a migration the elements [m_lo, m_hi) are in the old capacity (at the same indices) and the others are in
+// the new one. The other modifications finish the migration first (see settle), and then work on the contiguous
+// elements as dynamic_sequence_storage does, reallocating all at once if they need more capacity.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class migrating_sequence_storage : private ALLOC
+{
+	using value_type = T;
+	using pointer = value_type*;
+	using allocator_traits = std::allocator_traits<ALLOC>;
+
+	static constexpr size_t ALIGN = capacity_alignment<T, TRAITS>;
+	static constexpr bool over_aligned = ALIGN > alignof(T);
+
+public:
+
+	using allocator_type = ALLOC;
+	using iterator = migrating_iterator<value_type>;
+	using const_iterator = migrating_iterator<const value_type>;
+
+	migrating_sequence_storage() = default;
+	constexpr explicit migrating_sequence_storage(const allocator_type& alloc) : allocator_type(alloc) {}
+	constexpr migrating_sequence_storage(const migrating_sequence_storage& rhs) :
+		allocator_type(allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
+	{
+		assign_data(rhs.data_begin(), rhs.size());
+	}
+	constexpr migrating_sequence_storage(migrating_sequence_storage&& rhs) : allocator_type(rhs.get_allocator())
+	{
+		swap_data(rhs);
+	}
+	constexpr migrating_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		allocator_type(alloc)
+	{
+		assign_data(il.begin(), il.size());
+	}
+	constexpr ~migrating_sequence_storage()
+	{
+		clear();
+		deallocate(m_data, m_capacity);
+	}
+
+	constexpr migrating_sequence_storage& operator=(const migrating_sequence_storage& rhs)
+	{
+		if (this != &rhs)
+		{
+			clear();
+			if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+			{
+				if (!allocator_traits::is_always_equal::value && allocator() != rhs.allocator())
+				{
+					deallocate(m_data, m_capacity);
+					m_data = nullptr;
+					m_capacity = 0;
+				}
+				allocator() = rhs.allocator();
+			}
+			assign_data(rhs.data_begin(), rhs.size());
+		}
+		return *this;
+	}
+	constexpr migrating_sequence_storage& operator=(migrating_sequence_storage&& rhs)
+	{
+		if (this != &rhs)
+		{
+			// For LAZY discard the replaced elements are swapped into 'rhs' (if its capacity can be taken over).
+			if constexpr (TRAITS.discard != sequence_discard_lits::LAZY)
+				clear();
+			if (move_allocator(rhs))
+				swap_data(rhs);
+			else
+			{
+				clear();
+				assign_data(std::make_move_iterator(rhs.data_begin()), rhs.size());
+			}
+		}
+		return *this;
+	}
+
+	constexpr allocator_type get_allocator() const { return allocator(); }
+
+	constexpr size_t capacity() const { return m_capacity; }
+	constexpr size_t size() const { return m_size; }
+
+	constexpr iterator data_begin() { return iterator(m_data, m_old_data, m_lo, m_hi, 0); }
+	constexpr iterator data_end() { return iterator(m_data, m_old_data, m_lo, m_hi, m_size); }
+	constexpr const_iterator data_begin() const { return const_iterator(m_data, m_old_data, m_lo, m_hi, 0); }
+	constexpr const_iterator data_end() const { return const_iterator(m_data, m_old_data, m_lo, m_hi, m_size); }
+	constexpr const value_type* capacity_begin() const { return m_data; }
+	constexpr const value_type* capacity_end() const { return m_data + m_capacity; }
+
+	constexpr void swap(migrating_sequence_storage& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), rhs.allocator());
+		else
+			assert(allocator_traits::is_always_equal::value || allocator() == rhs.allocator());
+		swap_data(rhs);
+	}
+
+	// The holds function returns true if 'p' points to one of the elements, in either capacity.
+
+	constexpr bool holds(const value_type* p) const
+	{
+		return points_into(p, capacity_begin(), capacity_begin() + m_size) ||
+			   points_into<value_type>(p, m_old_data + m_lo, m_old_data + m_hi);
+	}
+
+	// The reallocate function (for reserve and shrink_to_fit) finishes any migration and then moves the
+	// elements into the new capacity at once.
+
+	constexpr void reallocate(size_t new_cap)
+	{
+		assert(size() <= new_cap);
+
+		settle();
+		count_event<T, TRAITS>(sequence_event::REALLOCATION);
+		auto [data, cap] = new_cap ? allocate(new_cap) : std::pair<pointer, size_t>(nullptr, 0);
+		relocate(m_data, m_data + m_size, data);
+		deallocate(m_data, m_capacity);
+		m_data = data;
+		m_capacity = cap;
+	}
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		size_t index = pos - data_begin();
+		assert(index <= size());
+
+		if (index == m_size)
+		{
+			add_back(std::forward<ARGS>(args)...);
+			return data_begin() + index;
+		}
+		if ((m_old_data || m_size == m_capacity) && !unaffected(args...))
+			return add_at(pos, value_type(std::forward<ARGS>(args)...));
+		make_room(1);
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, m_size - index);
+		back_add_at(m_data + m_size, m_data + index, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		return data_begin() + index;
+	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		size_t index = pos - data_begin();
+		assert(index <= size());
+
+		make_room(count);
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, m_size - index);
+		back_add_range_at(m_data + m_size, m_data + index, first, count, [this](size_t n){ m_size += n; });
+		return data_begin() + index;
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		add_at(data_begin(), std::forward<ARGS>(args)...);
+	}
+
+	// The add_back function constructs the element in the new capacity and then moves the next elements. (An
+	// unfinished migration must be finished before the capacity can grow again, which would invalidate arguments
+	// in the old capacity, so they are first copied.)
+
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		if (m_size == m_capacity)
+		{
+			if (m_old_data && !unaffected(args...))
+				return add_back(value_type(std::forward<ARGS>(args)...));
+			grow();
+		}
+		std::construct_at(m_data + m_size, std::forward<ARGS>(args)...);
+		++m_size;
+		migrate(TRAITS.migration_step);
+	}
+	template<typename... ARGS>
+	constexpr void add(size_t count, ARGS&&... args)
+	{
+		make_room(count);
+		construct_data(m_data + m_size, count, std::forward<ARGS>(args)...);
+		m_size += count;
+	}
+
+	constexpr void clear()
+	{
+		destroy_data(data_begin(), data_end());
+		m_size = 0;
+		deallocate(m_old_data, m_old_capacity);
+		m_old_data = nullptr;
+		m_old_capacity = m_lo = m_hi = 0;
+	}
+	constexpr void erase(iterator begin, iterator end)
+	{
+		size_t first = begin - data_begin();
+		size_t last = end - data_begin();
+		settle();
+		back_erase(m_data, m_data + m_size, m_data + first, m_data + last, [this](size_t count){ m_size -= count; });
+	}
+	constexpr void erase(iterator element)
+	{
+		size_t index = element - data_begin();
+		settle();
+		back_erase(m_data, m_data + m_size, m_data + index, [this](){ --m_size; });
+	}
+	constexpr void pop_front()
+	{
+		assert(size());
+
+		erase(data_begin());
+	}
+
+	// The pop_back function destroys the element at the back (in whichever capacity holds it) and then moves the
+	// next elements.
+
+	constexpr void pop_back()
+	{
+		assert(size());
+
+		--m_size;
+		if (m_size < m_hi)
+		{
+			std::destroy_at(m_old_data + m_size);
+			m_hi = m_size;
+		}
+		else
+			std::destroy_at(m_data + m_size);
+		migrate(TRAITS.migration_step);
+	}
+
+	// The linearize function finishes any migration and returns a pointer to the elements.
+
+	constexpr value_type* linearize()
+	{
+		settle();
+		return m_data;
+	}
+
+	// The adopt function clears the sequence and takes over the capacity and elements of a block, whose elements
+	// must be at the front. The release function finishes any migration and gives up the capacity and elements,
+	// leaving no capacity.
+
+	constexpr void adopt(const sequence_block<T>& block) requires (!over_aligned)
+	{
+		assert(block.front_gap == 0 && block.size <= block.capacity);
+
+		clear();
+		deallocate(m_data, m_capacity);
+		m_data = block.capacity_begin;
+		m_capacity = block.capacity;
+		m_size = block.size;
+	}
+	constexpr sequence_block<T> release() requires (!over_aligned)
+	{
+		settle();
+		sequence_block<T> block{m_data, m_capacity, 0, m_size};
+		m_data = nullptr;
+		m_capacity = m_size = 0;
+		return block;
+	}
+
+private:
+
+	constexpr allocator_type& allocator() { return *this; }
+	constexpr const allocator_type& allocator() const { return *this; }
+
+	constexpr std::pair<pointer, size_t> allocate(size_t cap)
+	{
+		auto [data, count] = sequence_allocate<ALIGN>(allocator(), cap);
+		count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
+		return {data, count};
+	}
+	constexpr void deallocate(pointer data, size_t cap)
+	{
+		if (data)
+			sequence_deallocate<ALIGN>(allocator(), data, cap);
+	}
+
+	// The unaffected function returns true if the elements can be moved (by settling or reallocating) without
+	// invalidating the arguments (see constructible_in_gap).
+
+	template<typename... ARGS>
+	constexpr bool unaffected(const ARGS&... args) const
+	{
+		return constructible_in_gap<value_type>(m_data, m_data + m_size, args...) &&
+			   constructible_in_gap<value_type>(m_old_data + m_lo, m_old_data + m_hi, args...);
+	}
+
+	// The grow function starts a migration into a new capacity (finishing any earlier one first). An empty
+	// sequence simply takes the new capacity.
+
+	constexpr void grow()
+	{
+		settle();
+		count_event<T, TRAITS>(sequence_event::REALLOCATION);
+		auto [data, cap] = allocate(TRAITS.grow(m_capacity));
+		if (m_size)
+		{
+			m_old_data = m_data;
+			m_old_capacity = m_capacity;
+			m_lo = 0;
+			m_hi = m_size;
+		}
+		else
+			deallocate(m_data, m_capacity);
+		m_data = data;
+		m_capacity = cap;
+	}
+
+	// The make_room function finishes any migration and ensures that there is capacity for 'count' more
+	// elements, growing once (all at once) to the larger of the required capacity and the normal growth step.
+
+	constexpr void make_room(size_t count)
+	{
+		settle();
+		if (auto required = m_size + count; required > m_capacity)
+			reallocate(std::max(required, TRAITS.grow(m_capacity)));
+	}
+
+	// The migrate function moves up to 'count' of the elements still in the old capacity, and deallocates the
+	// old capacity once they have all been moved. The settle function moves all of them.
+
+	constexpr void migrate(size_t count)
+	{
+		if (!m_old_data)
+			return;
+
+		count = std::min(count, m_hi - m_lo);
+		relocate(m_old_data + m_lo, m_old_data + m_lo + count, m_data + m_lo);
+		m_lo += count;
+		if (m_lo == m_hi)
+		{
+			deallocate(m_old_data, m_old_capacity);
+			m_old_data = nullptr;
+			m_old_capacity = m_lo = m_hi = 0;
+		}
+	}
+	constexpr void settle()
+	{
+		migrate(m_hi - m_lo);
+	}
+
+	// The assign_data function copies 'count' elements from the iterator into the empty sequence.
+
+	template<typename ITER>
+	constexpr void assign_data(ITER first, size_t count)
+	{
+		assert(m_size == 0);
+
+		if (count > m_capacity)
+			reallocate(count);
+		copy_data_n(first, count, m_data);
+		m_size = count;
+	}
+
+	// The move_allocator function returns true if the capacity of 'rhs' can be taken over by a move assignment.
+	// When the allocator propagates, the allocators are exchanged so that 'rhs' can take (and later destroy and
+	// deallocate) the current capacities and any elements left in them.
+
+	constexpr bool move_allocator(migrating_sequence_storage& rhs)
+	{
+		if constexpr (allocator_traits::is_always_equal::value)
+			return true;
+		else if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+		{
+			std::swap(allocator(), rhs.allocator());
+			return true;
+		}
+		else
+			return allocator() == rhs.allocator();
+	}
+	constexpr void swap_data(migrating_sequence_storage& rhs)
+	{
+		std::swap(m_data, rhs.m_data);
+		std::swap(m_capacity, rhs.m_capacity);
+		std::swap(m_size, rhs.m_size);
+		std::swap(m_old_data, rhs.m_old_data);
+		std::swap(m_old_capacity, rhs.m_old_capacity);
+		std::swap(m_lo, rhs.m_lo);
+		std::swap(m_hi, rhs.m_hi);
+	}
+
+	pointer m_data = nullptr;				// The (new) capacity.
+	size_t m_capacity = 0;
+	size_t m_size = 0;
+	pointer m_old_data = nullptr;			// The old capacity during a migration.
+	size_t m_old_capacity = 0;
+	size_t m_lo = 0;						// The elements still in the old capacity.
+	size_t m_hi = 0;
+};
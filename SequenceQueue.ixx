@@ -0,0 +1,274 @@
+export module sequence:queue;
+import :traits;
+import :fixed;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// Concurrent queues. These are bounded ring buffers over a fixed capacity (see fixed_capacity) which hand elements
+// from producer threads to one consumer thread without a lock. The head (read) and tail (write) counts are kept on
+// separate cache lines, and each side keeps a copy of the other side's count so that it reads the other side's
+// cache line only when the queue appears to be full (or empty). The counts increase monotonically and are mapped
+// onto the capacity, which is cheapest when the capacity is a power of 2.
+
+// queue_capacity - The capacity of a concurrent queue. STATIC storage embeds it in the queue. FIXED storage allocates
+// it (with the allocator rebound to the capacity type) when the queue is constructed and deallocates it when the
+// queue is destroyed.
+
+template<sequence_storage_lits STO, typename CAPACITY, typename ALLOC>
+class queue_capacity;
+
+template<typename CAPACITY, typename ALLOC>
+class queue_capacity<sequence_storage_lits::STATIC, CAPACITY, ALLOC>
+{
+public:
+
+	explicit queue_capacity(const ALLOC&) {}
+
+	auto capacity_begin() { return m_capacity.capacity_begin(); }
+
+private:
+
+	CAPACITY m_capacity;
+};
+
+template<typename CAPACITY, typename ALLOC>
+class queue_capacity<sequence_storage_lits::FIXED, CAPACITY, ALLOC> :
+	private std::allocator_traits<ALLOC>::template rebind_alloc<CAPACITY>
+{
+	using allocator_type = typename std::allocator_traits<ALLOC>::template rebind_alloc<CAPACITY>;
+	using allocator_traits = std::allocator_traits<allocator_type>;
+
+public:
+
+	explicit queue_capacity(const ALLOC& alloc) : allocator_type(alloc)
+	{
+		m_capacity = allocator_traits::allocate(allocator(), 1);
+		new(m_capacity) CAPACITY();
+	}
+	queue_capacity(const queue_capacity&) = delete;
+	queue_capacity& operator=(const queue_capacity&) = delete;
+	~queue_capacity()
+	{
+		m_capacity->~CAPACITY();
+		allocator_traits::deallocate(allocator(), m_capacity, 1);
+	}
+
+	auto capacity_begin() { return m_capacity->capacity_begin(); }
+
+private:
+
+	allocator_type& allocator() { return *this; }
+
+	CAPACITY* m_capacity = nullptr;
+};
+
+// ==============================================================================================================
+// concurrent_queue - A bounded queue of 'capacity' elements for one consumer thread and one producer thread (or any
+// number of producer threads if MULTI_PRODUCER). The capacity is allocated as specified by 'storage', which must be
+// STATIC or FIXED, and is aligned as specified by 'alignment'. (The other traits do not apply.)
+//
+// With one producer, both sides are wait-free. With multiple producers, each producer claims its slots with a
+// compare-exchange and publishes them in claim order once it has constructed its elements, so a producer waits
+// only for producers which claimed the slots just before its own. The consumer is wait-free in both cases.
+
+template<typename T, sequence_traits TRAITS, bool MULTI_PRODUCER, typename ALLOC>
+class concurrent_queue
+{
+	using capacity_type = queue_capacity<TRAITS.storage, fixed_capacity<T, TRAITS.capacity, capacity_alignment<T, TRAITS>>, ALLOC>;
+
+	static constexpr size_t CACHE_LINE = std::hardware_destructive_interference_size;
+
+public:
+
+	using value_type = T;
+	using allocator_type = ALLOC;
+	using traits_type = decltype(TRAITS);
+	static constexpr traits_type traits = TRAITS;
+
+	static_assert(traits.storage == sequence_storage_lits::STATIC || traits.storage == sequence_storage_lits::FIXED,
+				  "Concurrent queues require STATIC or FIXED storage.");
+	static_assert(traits.capacity > 0,
+				  "Capacity must be greater than 0.");
+
+	// A producer cannot give back slots it has claimed, so it must be able to fill them.
+	static_assert(!MULTI_PRODUCER || std::is_nothrow_move_constructible_v<T>,
+				  "Multiple producer queues require nothrow move-constructible types.");
+
+	concurrent_queue() : concurrent_queue(allocator_type()) {}
+	explicit concurrent_queue(const allocator_type& alloc) : m_capacity(alloc) {}
+	concurrent_queue(const concurrent_queue&) = delete;
+	concurrent_queue& operator=(const concurrent_queue&) = delete;
+	~concurrent_queue()
+	{
+		destroy(m_head.load(std::memory_order_relaxed), m_tail.load(std::memory_order_relaxed));
+	}
+
+	constexpr static size_t capacity() { return TRAITS.capacity; }
+
+	// The size function returns the number of published elements which have not been popped. This is a snapshot,
+	// since the other threads may be adding or removing elements.
+
+	size_t size() const
+	{
+		auto head = m_head.load(std::memory_order_acquire);
+		return m_tail.load(std::memory_order_acquire) - head;
+	}
+	bool empty() const { return size() == 0; }
+
+	// The producer functions. The try_push and try_emplace functions add an element at the back of the queue and
+	// publish it. They return false (and add nothing) if the queue is full. The try_push_n function adds as many of
+	// 'count' elements copied from 'first' as there is room for, publishes them together, and returns the number
+	// added. (With multiple producers, an element is constructed before its slot is claimed, and the bulk elements
+	// must be nothrow constructible from the iterator.)
+
+	bool try_push(const value_type& element) { return try_emplace(element); }
+	bool try_push(value_type&& element) { return try_emplace(std::move(element)); }
+
+	template<typename... ARGS>
+	bool try_emplace(ARGS&&... args)
+	{
+		if constexpr (MULTI_PRODUCER)
+		{
+			value_type element(std::forward<ARGS>(args)...);
+			auto [tail, claimed] = claim(1);
+			if (claimed == 0)
+				return false;
+			new(slot(tail)) value_type(std::move(element));
+			publish(tail, 1);
+		}
+		else
+		{
+			auto [tail, claimed] = claim(1);
+			if (claimed == 0)
+				return false;
+			new(slot(tail)) value_type(std::forward<ARGS>(args)...);
+			publish(tail, 1);
+		}
+		return true;
+	}
+
+	template<std::input_iterator ITER>
+		requires (!MULTI_PRODUCER || std::is_nothrow_constructible_v<T, std::iter_reference_t<ITER>>)
+	size_t try_push_n(ITER first, size_t count)
+	{
+		auto [tail, claimed] = claim(count);
+		size_t constructed = 0;
+		try
+		{
+			for (; constructed != claimed; ++constructed, ++first)
+				new(slot(tail + constructed)) value_type(*first);
+		}
+		catch (...)
+		{
+			destroy(tail, tail + constructed);
+			throw;
+		}
+		if (claimed)
+			publish(tail, claimed);
+		return claimed;
+	}
+
+	// The consumer functions. The try_pop function moves the element at the front of the queue into 'element' and
+	// removes it. It returns false if the queue is empty. The front_segment function returns the published elements
+	// at the front of the queue which are contiguous in the capacity (all of them unless they wrap around its end).
+	// The consumer may use them in place and then remove any number of them with pop_n, which publishes the free
+	// space to the producers.
+
+	bool try_pop(value_type& element)
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		if (head == m_cached_tail && (m_cached_tail = m_tail.load(std::memory_order_acquire)) == head)
+			return false;
+
+		auto p = slot(head);
+		element = std::move(*p);
+		p->~value_type();
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+	std::span<value_type> front_segment()
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		m_cached_tail = m_tail.load(std::memory_order_acquire);
+		auto offset = head % capacity();
+		return std::span(m_capacity.capacity_begin() + offset, std::min(m_cached_tail - head, capacity() - offset));
+	}
+	void pop_n(size_t count)
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		assert(count <= m_cached_tail - head);
+
+		destroy(head, head + count);
+		m_head.store(head + count, std::memory_order_release);
+	}
+
+private:
+
+	value_type* slot(size_t index) { return m_capacity.capacity_begin() + index % capacity(); }
+
+	void destroy(size_t begin, size_t end)
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			for (; begin != end; ++begin)
+				slot(begin)->~value_type();
+	}
+
+	// The claim function reserves up to 'count' slots at the back of the queue for the calling producer. It
+	// returns the count of the first slot and the number of slots claimed (0 if the queue is full).
+
+	std::pair<size_t, size_t> claim(size_t count)
+	{
+		if constexpr (MULTI_PRODUCER)
+		{
+			for (;;)
+			{
+				// The head is read first, so the claim count is never behind it.
+				auto head = m_head.load(std::memory_order_acquire);
+				auto tail = m_claim.load(std::memory_order_relaxed);
+				auto used = tail - head;
+				auto claimed = std::min(count, used < capacity() ? capacity() - used : 0);
+				if (claimed == 0 || m_claim.compare_exchange_weak(tail, tail + claimed, std::memory_order_relaxed))
+					return {tail, claimed};
+			}
+		}
+		else
+		{
+			auto tail = m_tail.load(std::memory_order_relaxed);
+			if (capacity() - (tail - m_cached_head) < count)
+				m_cached_head = m_head.load(std::memory_order_acquire);
+			return {tail, std::min(count, capacity() - (tail - m_cached_head))};
+		}
+	}
+
+	// The publish function makes claimed slots visible to the consumer. Multiple producers publish in claim order,
+	// so a producer first waits for the producers which claimed earlier slots.
+
+	void publish(size_t tail, size_t count)
+	{
+		if constexpr (MULTI_PRODUCER)
+			while (m_tail.load(std::memory_order_acquire) != tail)
+				std::this_thread::yield();
+		m_tail.store(tail + count, std::memory_order_release);
+	}
+
+	capacity_type m_capacity;
+
+	alignas(CACHE_LINE) std::atomic<size_t> m_head = 0;		// Written by the consumer.
+	size_t m_cached_tail = 0;								// The consumer's copy of m_tail.
+
+	alignas(CACHE_LINE) std::atomic<size_t> m_tail = 0;		// Written by the producers.
+	size_t m_cached_head = 0;								// The producer's copy of m_head (one producer only).
+	std::atomic<size_t> m_claim = 0;						// The claimed slots (multiple producers only).
+};
+
+// sequence_spsc_queue, sequence_mpsc_queue - Concurrent queues for one producer and for multiple producers (and one
+// consumer), built on STATIC or FIXED storage. For instance, a queue of STATIC sequences can hand per-thread buffers
+// to a consumer thread without a lock.
+
+export template<typename T, sequence_traits TRAITS, typename ALLOC = std::allocator<T>>
+using sequence_spsc_queue = concurrent_queue<T, TRAITS, false, ALLOC>;
+
+export template<typename T, sequence_traits TRAITS, typename ALLOC = std::allocator<T>>
+using sequence_mpsc_queue = concurrent_queue<T, TRAITS, true, ALLOC>;
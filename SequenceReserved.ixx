@@ -0,0 +1,251 @@
+module;
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+export module sequence:reserved;
+import :traits;
+import :statistics;
+import :utilities;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// Virtual memory functions. These reserve a range of address space, commit and decommit pages within it, and
+// release it. Reserved pages use no memory until they are committed.
+
+size_t page_size()
+{
+#if defined(_WIN32)
+	static const size_t size = []{ SYSTEM_INFO info; GetSystemInfo(&info); return size_t(info.dwPageSize); }();
+#else
+	static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+#endif
+	return size;
+}
+
+// The reserve_pages function returns nullptr (rather than throwing) if the range cannot be reserved. Huge page
+// advice is given where the system supports it for incrementally committed memory (transparent huge pages).
+
+void* reserve_pages(size_t bytes, bool huge_pages)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	auto p = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+#if defined(MADV_HUGEPAGE)
+	if (huge_pages)
+		madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	return p;
+#endif
+}
+bool commit_pages(void* p, size_t bytes)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(p, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+void decommit_pages(void* p, size_t bytes)
+{
+#if defined(_WIN32)
+	VirtualFree(p, bytes, MEM_DECOMMIT);
+#else
+	madvise(p, bytes, MADV_DONTNEED);
+	mprotect(p, bytes, PROT_NONE);
+#endif
+}
+void release_pages(void* p, size_t bytes)
+{
+#if defined(_WIN32)
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	munmap(p, bytes);
+#endif
+}
+
+// ==============================================================================================================
+// reserved_capacity - This is the capacity base class for RESERVED storage. The address space for 'reservation'
+// elements is reserved when the capacity is first needed, and the capacity is a window of committed pages within
+// it. Growing commits more pages around the elements, so the elements never move (unless a MIDDLE location
+// sequence reaches an end of the reservation and must be recentered). Shrinking decommits the pages outside
+// the new window. The window is widened to the whole of its pages, so the capacity may be larger than
+// requested (and it is limited to the reservation). The allocator is not used for the capacity.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class reserved_capacity : private ALLOC
+{
+	using value_type = T;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+	using allocator_traits = std::allocator_traits<ALLOC>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	reserved_capacity() = default;
+	explicit reserved_capacity(const allocator_type& alloc) : allocator_type(alloc) {}
+	reserved_capacity(size_t cap, const allocator_type& alloc = allocator_type()) : allocator_type(alloc)
+	{
+		reallocate(cap, nullptr, nullptr);
+	}
+	reserved_capacity(const reserved_capacity&) = delete;
+	~reserved_capacity()
+	{
+		deallocate();
+	}
+	reserved_capacity& operator=(const reserved_capacity&) = delete;
+
+	allocator_type get_allocator() const { return allocator(); }
+
+	size_t capacity() const { return capacity_end() - capacity_begin(); }
+	pointer capacity_begin() { return m_capacity_begin; }
+	pointer capacity_end() { return m_capacity_end; }
+	const_pointer capacity_begin() const { return m_capacity_begin; }
+	const_pointer capacity_end() const { return m_capacity_end; }
+
+	// The reservation is rounded up to whole pages.
+
+	static size_t reservation()
+	{
+		return reservation_bytes() / sizeof(value_type);
+	}
+
+protected:
+
+	allocator_type& allocator() { return *this; }
+	const allocator_type& allocator() const { return *this; }
+
+	// The reallocate function moves the capacity window so that it holds 'new_cap' elements, placing the
+	// elements within it according to the location (or the 'front_gap' function), and returns the beginning of
+	// the data (which does not move). The window is kept within the reservation. When there are no elements, the
+	// window is placed within the reservation according to the location. Growing beyond the reservation is
+	// limited to the reservation and throws std::bad_alloc if the capacity is already the whole reservation.
+
+	pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end)
+	{
+		return reallocate(new_cap, data_begin, data_end, [](size_t cap, size_t size){ return aligned_front_gap<T, TRAITS>(cap, size); });
+	}
+	template<std::regular_invocable<size_t, size_t> FUNC>
+	pointer reallocate(size_t new_cap, pointer data_begin, pointer data_end, FUNC front_gap)
+	{
+		size_t size = data_end - data_begin;
+
+		count_event<T, TRAITS>(sequence_event::REALLOCATION);
+		if (new_cap > reservation())
+		{
+			if (capacity() == reservation())
+				throw std::bad_alloc();
+			new_cap = reservation();
+		}
+		if (new_cap == 0)
+		{
+			deallocate();
+			return nullptr;
+		}
+		if (!m_reservation)
+		{
+			m_reservation = static_cast<pointer>(reserve_pages(reservation_bytes(), TRAITS.huge_pages));
+			if (!m_reservation)
+				throw std::bad_alloc();
+		}
+
+		size_t window = aligned_front_gap<T, TRAITS>(reservation(), new_cap);
+		if (size)
+		{
+			std::ptrdiff_t first = (data_begin - m_reservation) - std::ptrdiff_t(front_gap(new_cap, size));
+			window = size_t(std::clamp<std::ptrdiff_t>(first, 0, reservation() - new_cap));
+		}
+		commit(window, window + new_cap);
+		return size ? data_begin : m_capacity_begin + front_gap(capacity(), 0);
+	}
+	void deallocate()
+	{
+		if (m_reservation)
+			release_pages(m_reservation, reservation_bytes());
+		m_reservation = m_capacity_begin = m_capacity_end = nullptr;
+	}
+
+	// The allocator functions implement the std::allocator_traits propagation rules. Since the allocator does
+	// not own the capacity, the capacity can always be taken over by a move assignment.
+
+	void swap_allocator(reserved_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), rhs.allocator());
+	}
+	void copy_allocator(const reserved_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+			allocator() = rhs.allocator();
+	}
+	bool move_allocator(reserved_capacity& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+			std::swap(allocator(), rhs.allocator());
+		return true;
+	}
+	void swap_capacity(reserved_capacity& rhs, pointer& data_begin, pointer& data_end,
+					   pointer& rhs_data_begin, pointer& rhs_data_end)
+	{
+		std::swap(m_reservation, rhs.m_reservation);
+		std::swap(m_capacity_begin, rhs.m_capacity_begin);
+		std::swap(m_capacity_end, rhs.m_capacity_end);
+		std::swap(data_begin, rhs_data_begin);
+		std::swap(data_end, rhs_data_end);
+	}
+
+private:
+
+	static size_t reservation_bytes()
+	{
+		auto page = page_size();
+		return (TRAITS.reservation * sizeof(value_type) + page - 1) / page * page;
+	}
+
+	// The commit function commits the pages holding elements 'first' through 'last' of the reservation and
+	// decommits the pages of the current window outside them. The window becomes every element in those pages.
+
+	void commit(size_t first, size_t last)
+	{
+		auto page = page_size();
+		auto base = reinterpret_cast<char*>(m_reservation);
+		auto new_begin = base + first * sizeof(value_type) / page * page;
+		auto new_end = base + (last * sizeof(value_type) + page - 1) / page * page;
+
+		if (!commit_pages(new_begin, new_end - new_begin))
+			throw std::bad_alloc();
+		if (m_capacity_begin)
+		{
+			auto old_begin = reinterpret_cast<char*>(m_capacity_begin) - (reinterpret_cast<char*>(m_capacity_begin) - base) % page;
+			auto old_end = base + (reinterpret_cast<char*>(m_capacity_end) - base + page - 1) / page * page;
+			if (old_begin < new_begin)
+				decommit_pages(old_begin, std::min(new_begin, old_end) - old_begin);
+			if (old_end > new_end)
+				decommit_pages(std::max(new_end, old_begin), old_end - std::max(new_end, old_begin));
+			count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED,
+								   std::max<std::ptrdiff_t>((new_end - new_begin) - (old_end - old_begin), 0));
+		}
+		else
+			count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, new_end - new_begin);
+
+		m_capacity_begin = m_reservation + (new_begin - base + sizeof(value_type) - 1) / sizeof(value_type);
+		m_capacity_end = m_reservation + std::min<size_t>((new_end - base) / sizeof(value_type), reservation());
+	}
+
+	pointer m_reservation = nullptr;
+	pointer m_capacity_begin = nullptr;
+	pointer m_capacity_end = nullptr;
+};
@@ -0,0 +1,598 @@
+export module sequence:segmented;
+import :traits;
+import :allocator;
+import :statistics;
+import :utilities;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// segmented_sequence_storage - The element management for SEGMENTED storage. The elements are held in chunks of
+// 'capacity' elements, which are listed in order in an index of chunk pointers. Chunks are added at either end as
+// the elements need them, and the index grows (as specified by the growth traits, counting the elements its chunks
+// can hold) or is recentered when either end of it is reached. So adding an element at either end is O(1)
+// (amortized for the index), and the elements never move when the capacity grows.
+//
+// The chunks emptied by removing elements from either end are deallocated, except for one spare chunk which is kept
+// for the next chunk needed (so adding and removing elements at a chunk boundary does not allocate). Chunks added by
+// reserve are kept at the back. Elements inserted or erased within the sequence shift the nearer end. The location
+// determines where the index keeps its free entries (after the chunks for FRONT location, before them for BACK
+// location and on both sides for MIDDLE location).
+//
+// The contiguous function moves the elements into a single block of whole chunks, whose chunks then replace the
+// chunks in the index, so the elements are contiguous until a chunk is added. The block is deallocated when none of
+// its chunks are in use.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class segmented_sequence_storage : private ALLOC
+{
+	using value_type = T;
+	using chunk_pointer = value_type*;
+	using allocator_traits = std::allocator_traits<ALLOC>;
+	using index_allocator_type = typename allocator_traits::template rebind_alloc<chunk_pointer>;
+	using index_allocator_traits = std::allocator_traits<index_allocator_type>;
+
+	static constexpr size_t CHUNK = TRAITS.capacity;
+	static constexpr size_t ALIGN = capacity_alignment<T, TRAITS>;
+
+public:
+
+	using allocator_type = ALLOC;
+	using iterator = segmented_iterator<value_type, CHUNK>;
+	using const_iterator = segmented_iterator<const value_type, CHUNK>;
+
+	segmented_sequence_storage() = default;
+	constexpr explicit segmented_sequence_storage(const allocator_type& alloc) : allocator_type(alloc) {}
+	constexpr segmented_sequence_storage(const segmented_sequence_storage& rhs) :
+		allocator_type(allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
+	{
+		append_data(rhs.data_begin(), rhs.size());
+	}
+	constexpr segmented_sequence_storage(segmented_sequence_storage&& rhs) : allocator_type(rhs.get_allocator())
+	{
+		swap_data(rhs);
+	}
+	constexpr segmented_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		allocator_type(alloc)
+	{
+		append_data(il.begin(), il.size());
+	}
+	constexpr ~segmented_sequence_storage()
+	{
+		reset();
+	}
+
+	constexpr segmented_sequence_storage& operator=(const segmented_sequence_storage& rhs)
+	{
+		if (this != &rhs)
+		{
+			clear();
+			if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+			{
+				if (!allocator_traits::is_always_equal::value && allocator() != rhs.allocator())
+					reset();
+				allocator() = rhs.allocator();
+			}
+			append_data(rhs.data_begin(), rhs.size());
+		}
+		return *this;
+	}
+	constexpr segmented_sequence_storage& operator=(segmented_sequence_storage&& rhs)
+	{
+		if (this != &rhs)
+		{
+			// For LAZY discard the replaced elements are swapped into 'rhs' (if its capacity can be taken over).
+			if constexpr (TRAITS.discard != sequence_discard_lits::LAZY)
+				clear();
+			if (move_allocator(rhs))
+				swap_data(rhs);
+			else
+			{
+				clear();
+				append_data(std::make_move_iterator(rhs.data_begin()), rhs.size());
+			}
+		}
+		return *this;
+	}
+
+	constexpr allocator_type get_allocator() const { return allocator(); }
+
+	constexpr size_t capacity() const { return m_chunks * CHUNK; }
+	constexpr size_t size() const { return m_size; }
+
+	constexpr iterator data_begin() { return iterator(chunks(), m_head); }
+	constexpr iterator data_end() { return iterator(chunks(), m_head + m_size); }
+	constexpr const_iterator data_begin() const { return const_iterator(chunks(), m_head); }
+	constexpr const_iterator data_end() const { return const_iterator(chunks(), m_head + m_size); }
+	constexpr const_iterator capacity_begin() const { return const_iterator(chunks(), 0); }
+	constexpr const_iterator capacity_end() const { return const_iterator(chunks(), capacity()); }
+
+	constexpr void swap(segmented_sequence_storage& rhs)
+	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), rhs.allocator());
+		else
+			assert(allocator_traits::is_always_equal::value || allocator() == rhs.allocator());
+		swap_data(rhs);
+	}
+
+	// The reallocate function adds chunks at the back until the capacity is at least 'new_cap'. Reducing the
+	// capacity (for shrink_to_fit) deallocates the empty chunks at the back and the spare chunk.
+
+	constexpr void reallocate(size_t new_cap)
+	{
+		assert(size() <= new_cap);
+
+		if (new_cap > capacity())
+		{
+			while (capacity() < new_cap)
+				add_chunk_back();
+			return;
+		}
+		while (back_room() >= CHUNK)
+			free_chunk(m_index[m_first + --m_chunks]);
+		if (m_spare)
+			free_chunk(std::exchange(m_spare, nullptr));
+		if (m_chunks == 0)
+		{
+			free_index();
+			m_head = 0;
+		}
+	}
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		size_t index = pos - data_begin();
+		assert(index <= size());
+
+		if (index < size() - index)
+		{
+			add_front(std::forward<ARGS>(args)...);
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, index);
+			std::rotate(data_begin(), data_begin() + 1, data_begin() + index + 1);
+		}
+		else
+		{
+			add_back(std::forward<ARGS>(args)...);
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size() - 1 - index);
+			std::rotate(data_begin() + index, data_end() - 1, data_end());
+		}
+		return data_begin() + index;
+	}
+
+	// The add_range_at function constructs the new elements beyond the nearer end (adding chunks there as needed)
+	// and then rotates them into place, so the elements are not moved before the new ones are constructed.
+
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		size_t index = pos - data_begin();
+		assert(index <= size());
+
+		if (index < size() - index)
+		{
+			make_front_room(count);
+			try
+			{
+				copy_data_n(first, count, data_begin() - count);
+			}
+			catch (...)
+			{
+				trim_front();
+				throw;
+			}
+			m_head -= count;
+			m_size += count;
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, index);
+			std::rotate(data_begin(), data_begin() + count, data_begin() + count + index);
+		}
+		else
+		{
+			make_back_room(count);
+			copy_data_n(first, count, data_end());
+			m_size += count;
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size() - count - index);
+			std::rotate(data_begin() + index, data_end() - count, data_end());
+		}
+		return data_begin() + index;
+	}
+
+	// The add_front and add_back functions construct the element in a new chunk before adding the chunk to the
+	// index, so that the index is unchanged if the construction throws.
+
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		if (m_head == 0)
+		{
+			make_index_room(true);
+			auto chunk = take_chunk();
+			try
+			{
+				std::construct_at(chunk + CHUNK - 1, std::forward<ARGS>(args)...);
+			}
+			catch (...)
+			{
+				release_chunk(chunk);
+				throw;
+			}
+			m_index[--m_first] = chunk;
+			++m_chunks;
+			m_head = CHUNK - 1;
+		}
+		else
+		{
+			std::construct_at(address(m_head - 1), std::forward<ARGS>(args)...);
+			--m_head;
+		}
+		++m_size;
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		if (back_room() == 0)
+		{
+			make_index_room(false);
+			auto chunk = take_chunk();
+			try
+			{
+				std::construct_at(chunk, std::forward<ARGS>(args)...);
+			}
+			catch (...)
+			{
+				release_chunk(chunk);
+				throw;
+			}
+			m_index[m_first + m_chunks++] = chunk;
+		}
+		else
+			std::construct_at(address(m_head + m_size), std::forward<ARGS>(args)...);
+		++m_size;
+	}
+
+	// The add function constructs 'count' elements at the back one chunk at a time (see construct_data).
+
+	template<typename... ARGS>
+	constexpr void add(size_t count, ARGS&&... args)
+	{
+		make_back_room(count);
+		auto end = m_head + m_size;
+		auto offset = end;
+		try
+		{
+			for (auto last = end + count; offset != last;)
+			{
+				auto n = std::min(last - offset, CHUNK - offset % CHUNK);
+				construct_data(address(offset), n, args...);
+				offset += n;
+			}
+		}
+		catch (...)
+		{
+			destroy_data(iterator(chunks(), end), iterator(chunks(), offset));
+			throw;
+		}
+		m_size += count;
+	}
+
+	constexpr void clear()
+	{
+		destroy_data(data_begin(), data_end());
+		m_head = 0;
+		m_size = 0;
+	}
+
+	// The erase functions shift the elements at the nearer end over the erased elements, and then deallocate
+	// the chunks which that end has left empty (see trim_front and trim_back).
+
+	constexpr void erase(iterator begin, iterator end)
+	{
+		assert(begin >= data_begin() && begin <= end && end <= data_end());
+
+		size_t first = begin - data_begin();
+		size_t last = end - data_begin();
+		size_t count = last - first;
+		if (count == 0)
+			return;
+
+		if (first < size() - last)
+		{
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, first);
+			std::move_backward(data_begin(), begin, end);
+			destroy_data(data_begin(), data_begin() + count);
+			m_head += count;
+			m_size -= count;
+			trim_front();
+		}
+		else
+		{
+			auto old_room = back_room();
+			count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, size() - last);
+			std::move(end, data_end(), begin);
+			destroy_data(data_end() - count, data_end());
+			m_size -= count;
+			trim_back(old_room);
+		}
+	}
+	constexpr void erase(iterator element)
+	{
+		erase(element, element + 1);
+	}
+	constexpr void pop_front()
+	{
+		assert(size());
+
+		std::destroy_at(address(m_head));
+		++m_head;
+		--m_size;
+		trim_front();
+	}
+	constexpr void pop_back()
+	{
+		assert(size());
+
+		auto old_room = back_room();
+		std::destroy_at(address(m_head + m_size - 1));
+		--m_size;
+		trim_back(old_room);
+	}
+
+	// The holds function returns true if 'p' points to one of the elements (which may be in any chunk).
+
+	constexpr bool holds(const value_type* p) const
+	{
+		for (size_t i = 0, end = m_head + m_size; i < end; i += CHUNK)
+		{
+			auto chunk = chunks()[i / CHUNK];
+			if (points_into<value_type>(p, chunk + (i ? 0 : m_head), chunk + std::min(CHUNK, end - i)))
+				return true;
+		}
+		return false;
+	}
+
+	// The contiguous function returns a pointer to the elements, first moving them into a single block of whole
+	// chunks if they are not already contiguous. The chunks the elements were in (and any others) are deallocated.
+
+	constexpr value_type* contiguous()
+	{
+		if (m_size == 0)
+			return nullptr;
+
+		auto used = (m_head + m_size + CHUNK - 1) / CHUNK;
+		auto first = chunks()[0];
+		bool adjacent = true;
+		for (size_t i = 1; adjacent && i != used; ++i)
+			adjacent = chunks()[i] == first + i * CHUNK;
+		if (adjacent)
+			return first + m_head;
+
+		auto block_chunks = (m_size + CHUNK - 1) / CHUNK;
+		auto [block, count] = sequence_allocate<ALIGN>(allocator(), block_chunks * CHUNK);
+		count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
+		count_event<T, TRAITS>(sequence_event::ELEMENT_MOVE, m_size);
+
+		for (size_t offset = m_head, last = m_head + m_size, dst = 0; offset != last;)
+		{
+			auto n = std::min(last - offset, CHUNK - offset % CHUNK);
+			relocate(address(offset), address(offset) + n, block + dst);
+			offset += n;
+			dst += n;
+		}
+		for (size_t i = 0; i != m_chunks; ++i)
+			free_chunk(chunks()[i]);
+		if (m_spare)
+			free_chunk(std::exchange(m_spare, nullptr));
+
+		assert(!m_block);
+		m_block = block;
+		m_block_chunks = m_block_used = block_chunks;
+		for (size_t i = 0; i != block_chunks; ++i)
+			m_index[m_first + i] = block + i * CHUNK;
+		m_chunks = block_chunks;
+		m_head = 0;
+		return block;
+	}
+
+private:
+
+	constexpr allocator_type& allocator() { return *this; }
+	constexpr const allocator_type& allocator() const { return *this; }
+
+	constexpr chunk_pointer* chunks() { return m_index + m_first; }
+	constexpr const chunk_pointer* chunks() const { return m_index + m_first; }
+
+	// The address function returns the address of the element at 'offset' from the start of the first chunk.
+
+	constexpr value_type* address(size_t offset) { return chunks()[offset / CHUNK] + offset % CHUNK; }
+
+	constexpr size_t back_room() const { return capacity() - m_head - m_size; }
+
+	// The make_front_room and make_back_room functions add empty chunks at that end until there is room for
+	// 'count' elements.
+
+	constexpr void make_front_room(size_t count)
+	{
+		while (m_head < count)
+		{
+			make_index_room(true);
+			m_index[m_first - 1] = take_chunk();
+			--m_first;
+			++m_chunks;
+			m_head += CHUNK;
+		}
+	}
+	constexpr void make_back_room(size_t count)
+	{
+		while (back_room() < count)
+			add_chunk_back();
+	}
+	constexpr void add_chunk_back()
+	{
+		make_index_room(false);
+		m_index[m_first + m_chunks] = take_chunk();
+		++m_chunks;
+	}
+
+	// The trim functions release the chunks left empty at the front, and the chunks left empty at the back by
+	// removing elements (beyond those which were already empty, which were reserved).
+
+	constexpr void trim_front()
+	{
+		for (; m_head >= CHUNK; m_head -= CHUNK, --m_chunks)
+			release_chunk(m_index[m_first++]);
+		if (m_chunks == 0)
+			m_head = 0;
+	}
+	constexpr void trim_back(size_t old_room)
+	{
+		for (auto n = back_room() / CHUNK - old_room / CHUNK; n; --n)
+			release_chunk(m_index[m_first + --m_chunks]);
+		if (m_chunks == 0)
+			m_head = 0;
+	}
+
+	// The make_index_room function ensures that the index has a free entry before its chunks (at_front) or after
+	// them. If the index is less than half used its chunks are recentered within it, and otherwise it is
+	// reallocated. Either way at least half of the free entries are placed at the end which needs them.
+
+	constexpr void make_index_room(bool at_front)
+	{
+		if (at_front ? m_first > 0 : m_first + m_chunks < m_index_capacity)
+			return;
+
+		auto new_capacity = m_index_capacity;
+		if (m_chunks >= m_index_capacity / 2)
+			new_capacity = std::max(TRAITS.grow(m_index_capacity * CHUNK) / CHUNK, m_chunks + 1);
+
+		auto free = new_capacity - m_chunks;
+		size_t new_first = TRAITS.location == sequence_location_lits::FRONT ? 0 :
+						   TRAITS.location == sequence_location_lits::BACK ? free : free / 2;
+		new_first = at_front ? std::max(new_first, (free + 1) / 2) : std::min(new_first, free / 2);
+
+		if (new_capacity == m_index_capacity)
+		{
+			count_event<T, TRAITS>(sequence_event::RECENTER);
+			if (new_first < m_first)
+				std::copy(chunks(), chunks() + m_chunks, m_index + new_first);
+			else
+				std::copy_backward(chunks(), chunks() + m_chunks, m_index + new_first + m_chunks);
+		}
+		else
+		{
+			index_allocator_type alloc(allocator());
+			auto new_index = index_allocator_traits::allocate(alloc, new_capacity);
+			std::copy(chunks(), chunks() + m_chunks, new_index + new_first);
+			free_index();
+			m_index = new_index;
+			m_index_capacity = new_capacity;
+		}
+		m_first = new_first;
+	}
+	constexpr void free_index()
+	{
+		if (m_index)
+		{
+			index_allocator_type alloc(allocator());
+			index_allocator_traits::deallocate(alloc, m_index, m_index_capacity);
+		}
+		m_index = nullptr;
+		m_index_capacity = m_first = 0;
+	}
+
+	// The take_chunk function returns the spare chunk or allocates one. The release_chunk function keeps the chunk
+	// as the spare if there is none, and otherwise frees it. The free_chunk function deallocates a chunk, or for
+	// a chunk of the contiguous block, deallocates the block once none of its chunks are in use.
+
+	constexpr chunk_pointer take_chunk()
+	{
+		if (m_spare)
+			return std::exchange(m_spare, nullptr);
+		auto [chunk, count] = sequence_allocate<ALIGN>(allocator(), CHUNK);
+		count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, count * sizeof(value_type));
+		return chunk;
+	}
+	constexpr void release_chunk(chunk_pointer chunk)
+	{
+		if (!m_spare)
+			m_spare = chunk;
+		else
+			free_chunk(chunk);
+	}
+	constexpr void free_chunk(chunk_pointer chunk)
+	{
+		if (m_block && points_into<value_type>(chunk, m_block, m_block + m_block_chunks * CHUNK))
+		{
+			if (--m_block_used == 0)
+			{
+				sequence_deallocate<ALIGN>(allocator(), m_block, m_block_chunks * CHUNK);
+				m_block = nullptr;
+				m_block_chunks = 0;
+			}
+		}
+		else
+			sequence_deallocate<ALIGN>(allocator(), chunk, CHUNK);
+	}
+
+	// The reset function destroys the elements and deallocates the chunks and the index.
+
+	constexpr void reset()
+	{
+		clear();
+		for (size_t i = 0; i != m_chunks; ++i)
+			free_chunk(chunks()[i]);
+		m_chunks = 0;
+		if (m_spare)
+			free_chunk(std::exchange(m_spare, nullptr));
+		free_index();
+	}
+
+	// The append_data function adds 'count' elements constructed from the iterator at the back.
+
+	template<typename ITER>
+	constexpr void append_data(ITER first, size_t count)
+	{
+		make_back_room(count);
+		copy_data_n(first, count, data_end());
+		m_size += count;
+	}
+
+	constexpr bool move_allocator(segmented_sequence_storage& rhs)
+	{
+		if constexpr (allocator_traits::is_always_equal::value)
+			return true;
+		else if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+		{
+			reset();
+			allocator() = rhs.allocator();
+			return true;
+		}
+		else
+			return allocator() == rhs.allocator();
+	}
+	constexpr void swap_data(segmented_sequence_storage& rhs)
+	{
+		std::swap(m_index, rhs.m_index);
+		std::swap(m_index_capacity, rhs.m_index_capacity);
+		std::swap(m_first, rhs.m_first);
+		std::swap(m_chunks, rhs.m_chunks);
+		std::swap(m_head, rhs.m_head);
+		std::swap(m_size, rhs.m_size);
+		std::swap(m_spare, rhs.m_spare);
+		std::swap(m_block, rhs.m_block);
+		std::swap(m_block_chunks, rhs.m_block_chunks);
+		std::swap(m_block_used, rhs.m_block_used);
+	}
+
+	chunk_pointer* m_index = nullptr;		// The index of chunks.
+	size_t m_index_capacity = 0;
+	size_t m_first = 0;						// The index entry of the first chunk.
+	size_t m_chunks = 0;					// The number of chunks.
+	size_t m_head = 0;						// The offset of the first element in the first chunk.
+	size_t m_size = 0;
+	chunk_pointer m_spare = nullptr;		// A chunk kept for reuse.
+	chunk_pointer m_block = nullptr;		// The block allocated by contiguous.
+	size_t m_block_chunks = 0;
+	size_t m_block_used = 0;				// The chunks of the block in the index (or the spare).
+};
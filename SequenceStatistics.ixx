@@ -0,0 +1,160 @@
+export module sequence:statistics;
+import :traits;
+
+import std;
+import <assert.h>;
+
+// ==============================================================================================================
+// Statistics. When 'statistics' is set in the traits, the storage counts the events which reveal whether the
+// capacity traits suit the workload. The counts are kept per sequence type (element type and traits), so the
+// sequences at a call site can be given their own traits (even if only the 'statistics' flag differs) to measure
+// them separately. When 'statistics' is not set, the counting compiles to nothing.
+
+// sequence_statistics - A snapshot of the statistics for a sequence type (see sequence::statistics).
+
+export struct sequence_statistics
+{
+	size_t reallocations = 0;		// Number of times the capacity was reallocated (including in place).
+	size_t bytes_allocated = 0;		// Total bytes of capacity allocated (including temporary capacity).
+	size_t recenters = 0;			// Number of times MIDDLE location elements were recentered.
+	size_t spills = 0;				// Number of times BUFFERED elements moved from the buffer to dynamic capacity.
+	size_t rebuffers = 0;			// Number of times BUFFERED elements moved from dynamic capacity to the buffer.
+	size_t element_moves = 0;		// Number of elements shifted to make room for an insertion.
+};
+
+// sequence_event - The events counted. These index the counters below.
+
+enum class sequence_event { REALLOCATION, BYTES_ALLOCATED, RECENTER, SPILL, REBUFFER, ELEMENT_MOVE, COUNT };
+
+// The counters are relaxed atomics so that sequences of the same type may be used on any number of threads.
+// (They are only counters, so no ordering is needed.)
+
+template<typename T, sequence_traits TRAITS>
+std::array<std::atomic<size_t>, size_t(sequence_event::COUNT)> sequence_counters{};
+
+// The count_event function adds 'n' to the counter for an event if statistics are enabled. (Nothing is counted
+// in constant evaluation.)
+
+template<typename T, sequence_traits TRAITS>
+constexpr void count_event(sequence_event event, size_t n = 1)
+{
+	if constexpr (TRAITS.statistics)
+		if !consteval
+		{
+			sequence_counters<T, TRAITS>[size_t(event)].fetch_add(n, std::memory_order_relaxed);
+		}
+}
+
+// The statistics_snapshot function returns the current counts and the reset_statistics function zeroes them.
+
+template<typename T, sequence_traits TRAITS>
+sequence_statistics statistics_snapshot()
+{
+	auto count = [](sequence_event event){ return sequence_counters<T, TRAITS>[size_t(event)].load(std::memory_order_relaxed); };
+	return {count(sequence_event::REALLOCATION), count(sequence_event::BYTES_ALLOCATED), count(sequence_event::RECENTER),
+			count(sequence_event::SPILL), count(sequence_event::REBUFFER), count(sequence_event::ELEMENT_MOVE)};
+}
+
+template<typename T, sequence_traits TRAITS>
+void reset_statistics()
+{
+	for (auto& counter : sequence_counters<T, TRAITS>)
+		counter.store(0, std::memory_order_relaxed);
+}
+
+// ==============================================================================================================
+// Learned capacity. For LEARNED growth, each sequence records the largest size it reached in a histogram for its
+// type when it is destroyed, and the first dynamic allocation is taken from a percentile of the histogram.
+
+// The histogram has a bucket for each power of 2. Bucket 'k' counts the sequences whose high-water size was
+// greater than 2^(k-1) and no greater than 2^k, so the capacity it represents is 2^k.
+
+constexpr size_t HISTOGRAM_SIZE = std::numeric_limits<size_t>::digits;
+
+template<typename T, sequence_traits TRAITS>
+std::array<std::atomic<size_t>, HISTOGRAM_SIZE> sequence_size_histogram{};
+
+// The sequence_learned_capacity function returns the smallest capacity which would have held 'learned_percentile'
+// of the recorded sequences, or 'capacity' if none have been recorded (or in constant evaluation).
+
+template<typename T, sequence_traits TRAITS>
+constexpr size_t sequence_learned_capacity()
+{
+	if consteval
+	{
+		return TRAITS.capacity;
+	}
+
+	std::array<size_t, HISTOGRAM_SIZE> counts;
+	size_t total = 0;
+
+	for (size_t k = 0; k < HISTOGRAM_SIZE; ++k)
+		total += counts[k] = sequence_size_histogram<T, TRAITS>[k].load(std::memory_order_relaxed);
+	if (total == 0)
+		return TRAITS.capacity;
+
+	auto wanted = std::max<size_t>(size_t(std::ceil(total * double(TRAITS.learned_percentile))), 1);
+	size_t k = 0;
+	for (size_t seen = counts[0]; seen < wanted; seen += counts[++k]);
+	return size_t(1) << k;
+}
+
+// The sequence_grow function returns the capacity to grow to from 'cap', for the sequence and for storage which
+// grows on its own (MIDDLE location recentering). For LEARNED growth, the first dynamic allocation (from no
+// capacity, or from the buffer when not 'dynamic') is the learned capacity (if it is larger than 'cap').
+
+template<typename T, sequence_traits TRAITS>
+constexpr size_t sequence_grow(size_t cap, bool dynamic)
+{
+	if constexpr (TRAITS.growth == sequence_growth_lits::LEARNED)
+		if (cap == 0 || !dynamic)
+			if (auto learned = sequence_learned_capacity<T, TRAITS>(); learned > cap)
+				return learned;
+
+	auto new_cap = TRAITS.grow(cap);
+	assert(new_cap > cap);
+	return new_cap;
+}
+
+// capacity_profile - Base class for sequence which tracks the high-water size for LEARNED growth. The size is
+// noted before elements are removed, and the high-water size is recorded when the sequence is destroyed. The
+// mark belongs to the sequence object, so it is neither copied nor moved with the elements. Sequences which
+// never held any elements are not recorded. For the other growth modes this is empty and does nothing.
+
+template<typename T, sequence_traits TRAITS, bool LEARNED = TRAITS.growth == sequence_growth_lits::LEARNED>
+class capacity_profile
+{
+protected:
+
+	constexpr void note_size(size_t) {}
+	constexpr void record_size(size_t) {}
+};
+
+template<typename T, sequence_traits TRAITS>
+class capacity_profile<T, TRAITS, true>
+{
+protected:
+
+	capacity_profile() = default;
+	constexpr capacity_profile(const capacity_profile&) {}
+	constexpr capacity_profile& operator=(const capacity_profile&) { return *this; }
+
+	constexpr void note_size(size_t size) { m_high_water = std::max(m_high_water, size); }
+	constexpr void record_size(size_t size)
+	{
+		note_size(size);
+		if !consteval
+		{
+			if (m_high_water)
+				sequence_size_histogram<T, TRAITS>[std::bit_width(m_high_water - 1)].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// The learned_capacity function returns the learned first dynamic capacity (see sequence_learned_capacity).
+
+	constexpr static size_t learned_capacity() { return sequence_learned_capacity<T, TRAITS>(); }
+
+private:
+
+	size_t m_high_water = 0;
+};
@@ -1,82 +1,101 @@
 export module sequence:storage;
 import :traits;
+import :allocator;
+import :statistics;
 import :fixed;
 import :dynamic;
+import :reserved;
+import :segmented;
+import :migrating;
 
 import std;
 
 // ==============================================================================================================
-// sequence_storage - Base class for sequence which provides the 4 different memory allocation strategies.
+// sequence_storage - Base class for sequence which provides the different memory allocation strategies.
 
-template<sequence_storage_lits STO, typename T, sequence_traits TRAITS>
+template<sequence_storage_lits STO, typename T, sequence_traits TRAITS, typename ALLOC>
 class sequence_storage
 {
 	static_assert(false, "An unimplemented specialization of sequence_storage was instantiated.");
 };
 
-// STATIC storage (like std::inplace_vector or boost::static_vector).
+// STATIC storage (like std::inplace_vector or boost::static_vector). This storage never allocates,
+// so the allocator is accepted (for generic contexts) but not stored.
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<sequence_storage_lits::STATIC, T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::STATIC, T, TRAITS, ALLOC>
 {
 
 	using value_type = T;
-	using iterator = value_type*;
 	using size_type = typename decltype(TRAITS)::size_type;
 	using storage_type = fixed_sequence_storage<TRAITS.location, T, TRAITS>;
+	using iterator = decltype(std::declval<storage_type&>().data_begin());
 
 public:
 
+	using allocator_type = ALLOC;
+
 	sequence_storage() = default;
-	sequence_storage(std::initializer_list<value_type> il) : m_storage(il) {}
+	constexpr explicit sequence_storage(const allocator_type&) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& = allocator_type()) : m_storage(il) {}
+
+	constexpr allocator_type get_allocator() const { return allocator_type(); }
 
 	constexpr static size_t capacity() { return TRAITS.capacity; }
-	size_t size() const { return m_storage.size(); }
-	size_t max_size() const { return std::numeric_limits<size_type>::max(); }
-	bool is_dynamic() const { return false; }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr size_t max_size() const { return std::numeric_limits<size_type>::max(); }
+	constexpr bool is_dynamic() const { return false; }
 
-	void clear() { m_storage.clear(); }
-	void erase(value_type* begin, value_type* end) { m_storage.erase(begin, end); }
-	void erase(value_type* element) { m_storage.erase(element); }
-	void pop_front() { m_storage.pop_front(); }
-	void pop_back() { m_storage.pop_back(); }
+	constexpr void clear() { m_storage.clear(); }
+	constexpr void erase(iterator begin, iterator end) { m_storage.erase(begin, end); }
+	constexpr void erase(iterator element) { m_storage.erase(element); }
+	constexpr void pop_front() { m_storage.pop_front(); }
+	constexpr void pop_back() { m_storage.pop_back(); }
 
-	void swap(sequence_storage& other)
+	constexpr void swap(sequence_storage& other)
 	{
-		std::swap(m_storage, other.m_storage);
+		swap_fixed_storage(m_storage, other.m_storage);
 	}
 
 protected:
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		return m_storage.add_at(pos, std::forward<ARGS>(args)...);
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		return m_storage.add_range_at(pos, first, count);
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		m_storage.add_front(std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		m_storage.add_back(std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add(size_t new_size, ARGS&&... args)
+	constexpr void add(size_t new_size, ARGS&&... args)
 	{
 		m_storage.add(new_size, std::forward<ARGS>(args)...);
 	}
 
-	auto data_begin() { return m_storage.data_begin(); }
-	auto data_end() { return m_storage.data_end(); }
-	auto data_begin() const { return m_storage.data_begin(); }
-	auto data_end() const { return m_storage.data_end(); }
-	auto capacity_begin() const { return m_storage.capacity_begin(); }
-	auto capacity_end() const { return m_storage.capacity_end(); }
-
-	void reallocate(size_t new_capacity)
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+	constexpr auto linearize() { return m_storage.linearize(); }
+	constexpr auto segments() { return m_storage.segments(); }
+	constexpr auto segments() const { return m_storage.segments(); }
+
+	constexpr void reallocate(size_t new_capacity)
 	{
 		throw std::bad_alloc();
 	}
@@ -86,114 +105,278 @@ private:
 	storage_type m_storage;
 };
 
-// FIXED storage.
+// FIXED storage. The fixed_sequence_storage (which holds the sizes as well as the capacity) is allocated
+// as a single block using the allocator rebound to the storage type. Every block of the type is the same size,
+// so freed blocks may be kept for reuse (see sequence_traits::block_cache).
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<sequence_storage_lits::FIXED, T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::FIXED, T, TRAITS, ALLOC> : private ALLOC
 {
 	using value_type = T;
-	using iterator = value_type*;
 	using size_type = typename decltype(TRAITS)::size_type;
 	using storage_type = fixed_sequence_storage<TRAITS.location, T, TRAITS>;
+	using iterator = decltype(std::declval<storage_type&>().data_begin());
+	using allocator_traits = std::allocator_traits<ALLOC>;
+	using storage_allocator_type = typename allocator_traits::template rebind_alloc<storage_type>;
+	using storage_allocator_traits = std::allocator_traits<storage_allocator_type>;
+	using block_cache = sequence_block_cache<storage_type, storage_allocator_type, TRAITS.block_cache>;
+
+	static constexpr bool cached = TRAITS.block_cache > 0 && sizeof(storage_type) >= sizeof(void*);
 
 public:
 
+	using allocator_type = ALLOC;
+
 	sequence_storage() = default;
-	sequence_storage(std::initializer_list<value_type> il) : m_storage(new storage_type(il)) {}
+	constexpr explicit sequence_storage(const allocator_type& alloc) : allocator_type(alloc) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		allocator_type(alloc)
+	{
+		create(il);
+	}
+	constexpr sequence_storage(const sequence_storage& rhs) :
+		allocator_type(allocator_traits::select_on_container_copy_construction(rhs.get_allocator()))
+	{
+		if (rhs.m_storage)
+			create(std::as_const(*rhs.m_storage));
+	}
+	constexpr sequence_storage(sequence_storage&& rhs) : allocator_type(rhs.get_allocator())
+	{
+		std::swap(m_storage, rhs.m_storage);
+	}
+	constexpr ~sequence_storage()
+	{
+		destroy();
+	}
+
+	constexpr sequence_storage& operator=(const sequence_storage& rhs)
+	{
+		if (this != &rhs)
+		{
+			if constexpr (allocator_traits::propagate_on_container_copy_assignment::value)
+			{
+				if (!allocator_traits::is_always_equal::value && allocator() != rhs.allocator())
+					destroy();
+				allocator() = rhs.allocator();
+			}
+			if (!rhs.m_storage)
+				destroy();
+			else if (m_storage)
+				*m_storage = *rhs.m_storage;
+			else
+				create(std::as_const(*rhs.m_storage));
+		}
+		return *this;
+	}
+	constexpr sequence_storage& operator=(sequence_storage&& rhs)
+	{
+		if (this != &rhs)
+		{
+			// For LAZY discard the replaced elements are swapped into 'rhs' (with the allocator which can
+			// deallocate them) if its block can be taken over.
+			if constexpr (TRAITS.discard == sequence_discard_lits::LAZY)
+			{
+				if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+					std::swap(allocator(), rhs.allocator());
+				if (allocator_traits::propagate_on_container_move_assignment::value ||
+					allocator_traits::is_always_equal::value || allocator() == rhs.allocator())
+				{
+					std::swap(m_storage, rhs.m_storage);
+					return *this;
+				}
+			}
+			destroy();
+			if constexpr (allocator_traits::propagate_on_container_move_assignment::value)
+				allocator() = std::move(rhs.allocator());
+
+			// If the allocators differ the block cannot be taken over, so the elements are moved.
+			if (allocator_traits::propagate_on_container_move_assignment::value ||
+				allocator_traits::is_always_equal::value || allocator() == rhs.allocator())
+				std::swap(m_storage, rhs.m_storage);
+			else if (rhs.m_storage)
+				create(std::move(*rhs.m_storage));
+		}
+		return *this;
+	}
+
+	constexpr allocator_type get_allocator() const { return allocator(); }
 
 	constexpr static size_t capacity() { return TRAITS.capacity; }
-	size_t size() const { return m_storage ? m_storage->size() : 0; }
-	size_t max_size() const { return std::numeric_limits<size_type>::max(); }
-	bool is_dynamic() const { return true; }
+	constexpr size_t size() const { return m_storage ? m_storage->size() : 0; }
+	constexpr size_t max_size() const { return std::numeric_limits<size_type>::max(); }
+	constexpr bool is_dynamic() const { return true; }
 
-	void clear()
+	constexpr void clear()
+	{
+		destroy();
+	}
+	constexpr void erase(iterator begin, iterator end)
 	{
-		m_storage->clear();
-		m_storage.reset();
+		if (begin != end)
+			m_storage->erase(begin, end);
 	}
-	void erase(value_type* begin, value_type* end) { m_storage->erase(begin, end); }
-	void erase(value_type* element) { m_storage->erase(element); }
-	void pop_front() { m_storage->pop_front(); }
-	void pop_back() { m_storage->pop_back(); }
+	constexpr void erase(iterator element) { m_storage->erase(element); }
+	constexpr void pop_front() { m_storage->pop_front(); }
+	constexpr void pop_back() { m_storage->pop_back(); }
 
-	void swap(sequence_storage& other)
+	constexpr void swap(sequence_storage& other)
 	{
+		if constexpr (allocator_traits::propagate_on_container_swap::value)
+			std::swap(allocator(), other.allocator());
 		std::swap(m_storage, other.m_storage);
 	}
 
 protected:
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
 	{
 		if (!m_storage)
-			m_storage.reset(new storage_type);
+		{
+			create();
+			pos = m_storage->data_begin();
+		}
 		return m_storage->add_at(pos, std::forward<ARGS>(args)...);
 	}
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count)
+	{
+		if (!m_storage)
+		{
+			create();
+			pos = m_storage->data_begin();
+		}
+		return m_storage->add_range_at(pos, first, count);
+	}
 	template<typename... ARGS>
-	void add_front(ARGS&&... args)
+	constexpr void add_front(ARGS&&... args)
 	{
 		if (!m_storage)
-			m_storage.reset(new storage_type);
+			create();
 		m_storage->add_front(std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+	constexpr void add_back(ARGS&&... args)
 	{
 		if (!m_storage)
-			m_storage.reset(new storage_type);
+			create();
 		m_storage->add_back(std::forward<ARGS>(args)...);
 	}
 	template<typename... ARGS>
-	void add(size_t new_size, ARGS&&... args)
+	constexpr void add(size_t new_size, ARGS&&... args)
 	{
 		if (!m_storage)
-			m_storage.reset(new storage_type);
+			create();
 		m_storage->add(new_size, std::forward<ARGS>(args)...);
 	}
 
-	auto data_begin() { return m_storage ? m_storage->data_begin() : nullptr; }
-	auto data_end() { return m_storage ? m_storage->data_end() : nullptr; }
-	auto data_begin() const { return m_storage ? m_storage->data_begin() : nullptr; }
-	auto data_end() const { return m_storage ? m_storage->data_end() : nullptr; }
-	auto capacity_begin() const { return m_storage ? m_storage->capacity_begin() : nullptr; }
-	auto capacity_end() const { return m_storage ? m_storage->capacity_end() : nullptr; }
+	constexpr auto data_begin() { return m_storage ? m_storage->data_begin() : iterator(); }
+	constexpr auto data_end() { return m_storage ? m_storage->data_end() : iterator(); }
+	constexpr auto data_begin() const { return m_storage ? m_storage->data_begin() : iterator(); }
+	constexpr auto data_end() const { return m_storage ? m_storage->data_end() : iterator(); }
+	constexpr auto capacity_begin() const { return m_storage ? m_storage->capacity_begin() : nullptr; }
+	constexpr auto capacity_end() const { return m_storage ? m_storage->capacity_end() : nullptr; }
+	constexpr auto linearize() { return m_storage ? m_storage->linearize() : nullptr; }
+	constexpr auto segments() const { return m_storage ? m_storage->segments() : decltype(m_storage->segments())(); }
 
-	void reallocate(size_t new_capacity)
+	constexpr void reallocate(size_t new_capacity)
 	{
 		throw std::bad_alloc();
 	}
 
 private:
 
-	std::unique_ptr<storage_type> m_storage;
+	constexpr allocator_type& allocator() { return *this; }
+	constexpr const allocator_type& allocator() const { return *this; }
+
+	// The create and destroy functions allocate and deallocate the storage block.
+
+	template<typename... ARGS>
+	constexpr void create(ARGS&&... args)
+	{
+		assert(!m_storage);
+
+		storage_type* storage = nullptr;
+		if constexpr (cached)
+			if !consteval
+			{
+				storage = block_cache::allocate();
+			}
+		if (!storage)
+		{
+			storage_allocator_type alloc(allocator());
+			storage = storage_allocator_traits::allocate(alloc, 1);
+			count_event<T, TRAITS>(sequence_event::BYTES_ALLOCATED, sizeof(storage_type));
+		}
+		try
+		{
+			std::construct_at(storage, std::forward<ARGS>(args)...);
+		}
+		catch (...)
+		{
+			deallocate(storage);
+			throw;
+		}
+		m_storage = storage;
+	}
+	constexpr void destroy()
+	{
+		if (m_storage)
+		{
+			m_storage->~storage_type();
+			deallocate(m_storage);
+			m_storage = nullptr;
+		}
+	}
+	constexpr void deallocate(storage_type* storage)
+	{
+		if constexpr (cached)
+			if !consteval
+			{
+				block_cache::deallocate(storage);
+				return;
+			}
+		storage_allocator_type alloc(allocator());
+		storage_allocator_traits::deallocate(alloc, storage, 1);
+	}
+
+	storage_type* m_storage = nullptr;
 };
 
-// VARIABLE storage.
+// VARIABLE storage. Incremental reallocation (see sequence_traits::migration_step) uses the migrating storage,
+// whose iterators are not pointers.
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<sequence_storage_lits::VARIABLE, T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::VARIABLE, T, TRAITS, ALLOC>
 {
 	using value_type = T;
-	using iterator = value_type*;
+	using storage_type = std::conditional_t<TRAITS.migration_step != 0, migrating_sequence_storage<T, TRAITS, ALLOC>,
+											dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC>>;
+	using iterator = decltype(std::declval<storage_type&>().data_begin());
 
 public:
 
+	using allocator_type = ALLOC;
+
 	sequence_storage() = default;
-	sequence_storage(std::initializer_list<value_type> il) : m_storage(il) {}
+	constexpr explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc) {}
 
-	size_t capacity() const { return m_storage.capacity(); }
-	size_t size() const { return m_storage.size(); }
-	size_t max_size() const { return std::numeric_limits<size_t>::max(); }
-	bool is_dynamic() const { return true; }
+	constexpr allocator_type get_allocator() const { return m_storage.get_allocator(); }
 
-	void clear() { m_storage.clear(); }
-	void erase(value_type* begin, value_type* end) { m_storage.erase(begin, end); }
-	void erase(value_type* element) { m_storage.erase(element); }
-	void pop_front() { m_storage.pop_front(); }
-	void pop_back() { m_storage.pop_back(); }
+	constexpr size_t capacity() const { return m_storage.capacity(); }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr size_t max_size() const { return std::numeric_limits<size_t>::max(); }
+	constexpr bool is_dynamic() const { return true; }
 
-	void swap(sequence_storage& other)
+	constexpr void clear() { m_storage.clear(); }
+	constexpr void erase(iterator begin, iterator end) { m_storage.erase(begin, end); }
+	constexpr void erase(iterator element) { m_storage.erase(element); }
+	constexpr void pop_front() { m_storage.pop_front(); }
+	constexpr void pop_back() { m_storage.pop_back(); }
+
+	constexpr void swap(sequence_storage& other)
 	{
 		m_storage.swap(other.m_storage);
 	}
@@ -201,183 +384,357 @@ public:
 protected:
 
 	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	constexpr iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count) { return m_storage.add_range_at(pos, first, count); }
 	template<typename... ARGS>
-	void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	constexpr void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
 	template<typename... ARGS>
-	void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	constexpr void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
 	template<typename... ARGS>
-	void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
-
-	auto data_begin() { return m_storage.data_begin(); }
-	auto data_end() { return m_storage.data_end(); }
-	auto data_begin() const { return m_storage.data_begin(); }
-	auto data_end() const { return m_storage.data_end(); }
-	auto capacity_begin() const { return m_storage.capacity_begin(); }
-	auto capacity_end() const { return m_storage.capacity_end(); }
-
-	void reallocate(size_t new_capacity)
+	constexpr void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
+
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+	constexpr auto linearize() { return m_storage.linearize(); }
+	constexpr bool holds(const value_type* p) const { return m_storage.holds(p); }
+
+	constexpr void reallocate(size_t new_capacity)
 	{
 		m_storage.reallocate(new_capacity);
 	}
 
+	constexpr void adopt(const sequence_block<T>& block) { m_storage.adopt(block); }
+	constexpr sequence_block<T> release() { return m_storage.release(); }
+
 private:
 
-	dynamic_sequence_storage<TRAITS.location, T, TRAITS> m_storage;
+	storage_type m_storage;
 };
 
 // BUFFERED storage supporting a small object buffer optimization (like boost::small_vector).
+// This uses the same element management as VARIABLE storage, but over a buffered_capacity, whose capacity
+// pointers point into the buffer until the elements outgrow it. So the accessors do not depend on whether
+// the elements are buffered, and is_dynamic is a pointer comparison.
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<sequence_storage_lits::BUFFERED, T, TRAITS>
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::BUFFERED, T, TRAITS, ALLOC>
 {
 	using value_type = T;
 	using iterator = value_type*;
-	using fixed_type = fixed_sequence_storage<TRAITS.location, T, TRAITS>;		// STC
-	using dynamic_type = dynamic_sequence_storage<TRAITS.location, T, TRAITS>;	// DYN
-	enum { STC, DYN };
+	using capacity_type = buffered_capacity<T, TRAITS, ALLOC>;
 
 public:
 
+	using allocator_type = ALLOC;
+
 	sequence_storage() = default;
-	sequence_storage(std::initializer_list<value_type> il)
+	constexpr explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc) {}
+
+	constexpr allocator_type get_allocator() const { return m_storage.get_allocator(); }
+
+	constexpr size_t capacity() const { return m_storage.capacity(); }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr size_t max_size() const { return std::numeric_limits<size_t>::max(); }
+	constexpr bool is_dynamic() const { return m_storage.is_dynamic(); }
+
+	constexpr void clear() { m_storage.reset(); }
+	constexpr void erase(value_type* begin, value_type* end) { m_storage.erase(begin, end); }
+	constexpr void erase(value_type* element) { m_storage.erase(element); }
+	constexpr void pop_front() { m_storage.pop_front(); }
+	constexpr void pop_back() { m_storage.pop_back(); }
+
+	constexpr void swap(sequence_storage& other)
 	{
-		if (il.size() <= TRAITS.capacity)
-			m_storage.emplace<STC>(il);
-		else
-			m_storage.emplace<DYN>(il);
+		m_storage.swap(other.m_storage);
 	}
 
-	size_t capacity() const { return m_storage.index() == STC ? get<STC>(m_storage).capacity() : get<DYN>(m_storage).capacity(); }
-	size_t size() const { return m_storage.index() == STC ? get<STC>(m_storage).size() : get<DYN>(m_storage).size(); }
-	size_t max_size() const { return std::numeric_limits<size_t>::max(); }
-	bool is_dynamic() const { return m_storage.index() == DYN; }
+protected:
 
-	void clear()
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count) { return m_storage.add_range_at(pos, first, count); }
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
+
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+
+	constexpr void reallocate(size_t new_capacity)
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).clear();
-		else
-			m_storage.emplace<STC>();
+		m_storage.reallocate(new_capacity);
 	}
-	void erase(value_type* begin, value_type* end)
+
+private:
+
+	dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC, capacity_type> m_storage;
+};
+
+// RESERVED storage for very large sequences. This uses the same element management as VARIABLE storage, but over
+// a reserved_capacity, which grows by committing pages within a reserved address range (so the elements do not move).
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::RESERVED, T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using capacity_type = reserved_capacity<T, TRAITS, ALLOC>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	sequence_storage() = default;
+	constexpr explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc) {}
+
+	constexpr allocator_type get_allocator() const { return m_storage.get_allocator(); }
+
+	constexpr size_t capacity() const { return m_storage.capacity(); }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr size_t max_size() const { return capacity_type::reservation(); }
+	constexpr bool is_dynamic() const { return true; }
+
+	constexpr void clear() { m_storage.clear(); }
+	constexpr void erase(value_type* begin, value_type* end) { m_storage.erase(begin, end); }
+	constexpr void erase(value_type* element) { m_storage.erase(element); }
+	constexpr void pop_front() { m_storage.pop_front(); }
+	constexpr void pop_back() { m_storage.pop_back(); }
+
+	constexpr void swap(sequence_storage& other)
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).erase(begin, end);
-		else
-			get<DYN>(m_storage).erase(begin, end);
+		m_storage.swap(other.m_storage);
 	}
-	void erase(value_type* element)
+
+protected:
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count) { return m_storage.add_range_at(pos, first, count); }
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
+
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+
+	constexpr void reallocate(size_t new_capacity)
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).erase(element);
-		else
-			get<DYN>(m_storage).erase(element);
+		m_storage.reallocate(new_capacity);
 	}
-	void pop_front()
+
+private:
+
+	dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC, capacity_type> m_storage;
+};
+
+// SEGMENTED storage, which holds the elements in chunks that never move (see segmented_sequence_storage).
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<sequence_storage_lits::SEGMENTED, T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using storage_type = segmented_sequence_storage<T, TRAITS, ALLOC>;
+	using iterator = typename storage_type::iterator;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	sequence_storage() = default;
+	constexpr explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc) {}
+
+	constexpr allocator_type get_allocator() const { return m_storage.get_allocator(); }
+
+	constexpr size_t capacity() const { return m_storage.capacity(); }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr size_t max_size() const { return std::numeric_limits<size_t>::max(); }
+	constexpr bool is_dynamic() const { return true; }
+
+	constexpr void clear() { m_storage.clear(); }
+	constexpr void erase(iterator begin, iterator end) { m_storage.erase(begin, end); }
+	constexpr void erase(iterator element) { m_storage.erase(element); }
+	constexpr void pop_front() { m_storage.pop_front(); }
+	constexpr void pop_back() { m_storage.pop_back(); }
+
+	constexpr void swap(sequence_storage& other)
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).pop_front();
-		else
-			get<DYN>(m_storage).pop_front();
+		m_storage.swap(other.m_storage);
 	}
-	void pop_back()
+
+protected:
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename ITER>
+	constexpr iterator add_range_at(iterator pos, ITER first, size_t count) { return m_storage.add_range_at(pos, first, count); }
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	constexpr void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
+
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+	constexpr auto contiguous() { return m_storage.contiguous(); }
+	constexpr bool holds(const value_type* p) const { return m_storage.holds(p); }
+
+	constexpr void reallocate(size_t new_capacity)
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).pop_back();
-		else
-			get<DYN>(m_storage).pop_back();
+		m_storage.reallocate(new_capacity);
 	}
 
-	void swap(sequence_storage& other)
+private:
+
+	storage_type m_storage;
+};
+
+// ==============================================================================================================
+// sequence_reclaimer - The queue of storages discarded by sequences of one type for DEFERRED discard (see
+// sequence_traits::discard). A discarded storage is moved (with its elements and capacity) into a node of the
+// queue, which takes over its capacity without moving the elements (except buffered ones). The nodes are allocated
+// by the storage's allocator (rebound), so they come from wherever its capacity does. The reclaim function
+// destroys the queued storages. Any storages still queued are destroyed at exit, after which storages are no
+// longer queued. (The queue itself is never destroyed, so this holds for sequences destroyed at any time.)
+
+template<typename STORAGE>
+class sequence_reclaimer
+{
+public:
+
+	// The defer function queues the contents of 'storage', leaving it empty. If a node cannot be allocated (or the
+	// storage cannot be moved), or the queue has been reclaimed at exit, the storage is left as it was, to be
+	// destroyed by its owner.
+
+	static void defer(STORAGE& storage) noexcept
 	{
-		auto swap_mixed = [](sequence_storage& stc, sequence_storage& dyn)
-		{
-			assert(stc.m_storage.index() == STC);
-			assert(dyn.m_storage.index() == DYN);
+		static reaper exit_reclaim;
 
-			dynamic_type temp = std::move(get<DYN>(dyn.m_storage));
-			dyn.m_storage.emplace<STC>(std::move(get<STC>(stc.m_storage)));
-			stc.m_storage.emplace<DYN>(std::move(temp));
-		};
+		auto& queue = shared_queue();
+		if (queue.torn_down.load(std::memory_order_acquire))
+			return;
 
-		if (m_storage.index() == STC)
+		node_allocator alloc(storage.get_allocator());
+		node* discarded = nullptr;
+		try
 		{
-			if (other.m_storage.index() == STC)
-				std::swap(get<STC>(m_storage), get<STC>(other.m_storage));
-			else
-				swap_mixed(*this, other);
+			discarded = node_traits::allocate(alloc, 1);
+			node_traits::construct(alloc, discarded, std::move(storage));
 		}
-		else
+		catch (...)
 		{
-			if (other.m_storage.index() == STC)
-				swap_mixed(other, *this);
-			else
-				get<DYN>(m_storage).swap(get<DYN>(other.m_storage));
+			if (discarded)
+				node_traits::deallocate(alloc, discarded, 1);
+			return;
 		}
+
+		{
+			std::scoped_lock lock(queue.mutex);
+			if (!queue.torn_down.load(std::memory_order_relaxed))
+			{
+				discarded->next = queue.head;
+				queue.head = discarded;
+				return;
+			}
+		}
+		destroy(discarded);
 	}
 
-protected:
+	// The reclaim function destroys the queued storages (outside the lock) and returns how many there were.
 
-	template<typename... ARGS>
-	iterator add_at(iterator pos, ARGS&&... args)
+	static size_t reclaim()
 	{
-		if (m_storage.index() == STC)
-			return get<STC>(m_storage).add_at(pos, std::forward<ARGS>(args)...);
-		else
-			return get<DYN>(m_storage).add_at(pos, std::forward<ARGS>(args)...);
-	}
-	template<typename... ARGS>
-	void add_front(ARGS&&... args)
-	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).add_front(std::forward<ARGS>(args)...);
-		else
-			get<DYN>(m_storage).add_front(std::forward<ARGS>(args)...);
+		node* discarded;
+		{
+			auto& queue = shared_queue();
+			std::scoped_lock lock(queue.mutex);
+			discarded = std::exchange(queue.head, nullptr);
+		}
+		return destroy(discarded);
 	}
-	template<typename... ARGS>
-	void add_back(ARGS&&... args)
+
+private:
+
+	struct node
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).add_back(std::forward<ARGS>(args)...);
-		else
-			get<DYN>(m_storage).add_back(std::forward<ARGS>(args)...);
-	}
-	template<typename... ARGS>
-	void add(size_t new_size, ARGS&&... args)
+		node(STORAGE&& discarded) : storage(std::move(discarded)) {}
+
+		STORAGE storage;
+		node* next = nullptr;
+	};
+	using node_allocator = typename std::allocator_traits<typename STORAGE::allocator_type>::template rebind_alloc<node>;
+	using node_traits = std::allocator_traits<node_allocator>;
+
+	struct queue
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).add(new_size, std::forward<ARGS>(args)...);
-		else
-			get<DYN>(m_storage).add(new_size, std::forward<ARGS>(args)...);
-	}
+		std::mutex mutex;
+		node* head = nullptr;
+		std::atomic<bool> torn_down = false;
+	};
 
-	auto data_begin() { return m_storage.index() == STC ? get<STC>(m_storage).data_begin() : get<DYN>(m_storage).data_begin(); }
-	auto data_end() { return m_storage.index() == STC ? get<STC>(m_storage).data_end() : get<DYN>(m_storage).data_end(); }
-	auto data_begin() const { return m_storage.index() == STC ? get<STC>(m_storage).data_begin() : get<DYN>(m_storage).data_begin(); }
-	auto data_end() const { return m_storage.index() == STC ? get<STC>(m_storage).data_end() : get<DYN>(m_storage).data_end(); }
-	auto capacity_begin() const { return m_storage.index() == STC ? get<STC>(m_storage).capacity_begin() : get<DYN>(m_storage).capacity_begin(); }
-	auto capacity_end() const { return m_storage.index() == STC ? get<STC>(m_storage).capacity_end() : get<DYN>(m_storage).capacity_end(); }
+	// The reaper is constructed by the first defer, so it is destroyed before any sequence which was constructed
+	// (or queued storage) after it. Sequences destroyed later find the queue torn down and destroy their elements.
 
-	void reallocate(size_t new_capacity)
+	struct reaper
 	{
-		// The new capacity will not fit in the buffer.
-		if (new_capacity > TRAITS.capacity)
+		~reaper()
 		{
-			if (m_storage.index() == STC)		// We're moving out of the buffer: switch to dynamic storage.
-				m_storage = dynamic_type(new_capacity, get<STC>(m_storage));
-			else								// We're already out of the buffer: adjust the dynamic capacity.		
-				get<DYN>(m_storage).reallocate(new_capacity);
+			auto& queue = shared_queue();
+			{
+				std::scoped_lock lock(queue.mutex);
+				queue.torn_down.store(true, std::memory_order_release);
+			}
+			reclaim();
 		}
+	};
 
-		// The new capacity will fit in the buffer.
-		else if (m_storage.index() == DYN)		// We're moving into the buffer: switch to buffer storage.
-				m_storage.emplace<STC>(dynamic_type(std::move(get<DYN>(m_storage))));
-		// If we're already in the buffer: do nothing (the buffer capacity cannot change).
+	static queue& shared_queue()
+	{
+		static queue& discarded = *new queue;
+		return discarded;
+	}
+	static size_t destroy(node* discarded)
+	{
+		size_t count = 0;
+		for (; discarded; ++count)
+		{
+			auto next = discarded->next;
+			node_allocator alloc(discarded->storage.get_allocator());
+			node_traits::destroy(alloc, discarded);
+			node_traits::deallocate(alloc, discarded, 1);
+			discarded = next;
+		}
+		return count;
 	}
-
-private:
-
-	std::variant<fixed_type, dynamic_type> m_storage;
 };
-
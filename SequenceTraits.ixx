@@ -5,9 +5,19 @@ import std;
 // These are hoisted out of the class template to avoid template dependencies.
 // See sequence_traits below for a detailed discussion of these values.
 
-export enum class sequence_storage_lits { STATIC, FIXED, VARIABLE, BUFFERED };	// See sequence_traits::storage.
-export enum class sequence_location_lits { FRONT, BACK, MIDDLE };				// See sequence_traits::location.
-export enum class sequence_growth_lits { LINEAR, EXPONENTIAL, VECTOR };			// See sequence_traits::growth.
+export enum class sequence_storage_lits { STATIC, FIXED, VARIABLE, BUFFERED, RESERVED, SEGMENTED };	// See sequence_traits::storage.
+export enum class sequence_location_lits { FRONT, BACK, MIDDLE, CIRCULAR };		// See sequence_traits::location.
+export enum class sequence_growth_lits { LINEAR, EXPONENTIAL, VECTOR, LEARNED, CUSTOM };	// See sequence_traits::growth.
+export enum class sequence_discard_lits { EAGER, LAZY, DEFERRED };	// See sequence_traits::discard.
+
+// sequence_trivially_relocatable - Indicates that an element can be moved to a new address by copying its bytes,
+// after which the original is considered destroyed (trivial relocation). This allows elements to be moved by
+// memcpy/memmove when the capacity is reallocated or recentered and when elements are erased. It is true for
+// trivially copyable types. It may be specialized to be true for other types, but only for those that do not
+// hold pointers into themselves (many std::string implementations do, for example).
+
+export template<typename T>
+constexpr bool sequence_trivially_relocatable = std::is_trivially_copyable_v<T>;
 
 // sequence_traits - Structure used to supply the sequence traits. The default values have been chosen
 // to exactly model std::vector so that sequence can be used as a drop-in replacement with no adjustments.
@@ -15,9 +25,9 @@ export enum class sequence_growth_lits { LINEAR, EXPONENTIAL, VECTOR };			// See
 export template<std::unsigned_integral SIZE = size_t>
 struct sequence_traits
 {
-	// 'size_type' is the type of the size field for fixed storage. This allows small sequences of
-	// small types to be made significantly more space efficient by representing the size with a
-	// smaller type than size_t. This size reduction may (or may not) also result in faster run times.
+	// 'size_type' is the public size_type of the sequence and sets its max_size. It does not set the
+	// type of the size field of fixed storage, which is the smallest type that can represent the fixed
+	// capacity (see fixed_size_type below), so small fixed sequences are compact with the default.
 	// (Note that this type is not used in this structure. Using it for 'capacity' complicates
 	// the code without offering any real benefits, and it's not correct for 'increment'
 	// because the SBO (see below) may be small but the dynamic size large.)
@@ -48,6 +58,22 @@ struct sequence_traits
 	//			effect (as with std::vector). Calling it when the capacity is dynamically allocated and the
 	//			size is less than or equal to the fixed capacity size causes the capacity to be rebuffered
 	//			and the dynamic capacity to be deallocated.
+	//
+	// RESERVED	The address space for 'reservation' elements is reserved (but not allocated) when the capacity is first
+	//			needed, and the capacity grows by committing pages within it. The capacity can change but the elements
+	//			do not move (so pointers to the elements remain valid as the capacity grows). The capacity cannot
+	//			grow beyond the reservation. Neither clearing nor erasing the sequence deallocates the capacity.
+	//			Calling shrink_to_fit decommits the pages which are no longer needed. This is intended for very
+	//			large sequences, since each one reserves its whole address range.
+	//
+	// SEGMENTED	The capacity is dynamically allocated in chunks of 'capacity' elements, which are listed in an
+	//			index (like std::deque). Chunks are added and removed at either end as the elements need them, so
+	//			the elements never move as the capacity grows and push_back and push_front are O(1). The index
+	//			grows as specified by 'growth'. The iterators are random access but are not pointers, so data()
+	//			is not available; sequence::contiguous moves the elements into one block when that is needed.
+	//			Clearing the sequence does not deallocate the capacity. Erasing the sequence deallocates the
+	//			chunks it empties (except for one kept for reuse). Calling shrink_to_fit deallocates the empty
+	//			chunks. A power of 2 'capacity' makes indexing a shift.
 
 	sequence_storage_lits storage = sequence_storage_lits::VARIABLE;
 
@@ -61,6 +87,12 @@ struct sequence_traits
 	// 
 	//	MIDDLE	Data floats in the middle of the capacity.
 	//			This makes both push_back and push_front efficient (similar to std::deque).
+	//
+	//	CIRCULAR	Data wraps around the end of the capacity (a ring buffer). This makes push_back, push_front,
+	//			pop_back and pop_front O(1) without ever moving the other elements. It is only available for
+	//			STATIC and FIXED storage. The iterators are random access but are not pointers, so data() is not
+	//			available. The elements are contiguous in at most two parts (see sequence::segments), and
+	//			sequence::linearize moves them into one part at the start of the capacity.
 
 	sequence_location_lits location = sequence_location_lits::FRONT;
 
@@ -74,16 +106,49 @@ struct sequence_traits
 	//				It is provided so that sequence can be used as an implementation of std::vector and/or a
 	//				drop-in replacement for std::vector with no changes in behavior, even if the std::vector
 	//				growth behavior cannot be otherwise modeled with LINEAR or EXPONENTIAL growth modes.
+	//
+	//	LEARNED		The first dynamic allocation is sized from the high-water sizes of earlier sequences of the
+	//				same type (see 'learned_percentile'). After that, capacity grows in the same way as VECTOR.
+	//
+	//	CUSTOM		Capacity grows as specified by 'growth_function'.
 
 	sequence_growth_lits growth = sequence_growth_lits::VECTOR;
 
-	// 'capacity' is the size of the fixed capacity for STATIC and FIXED storages.
-	// For VARIABLE storage 'capacity' is the initial capacity when allocation first occurs.
+	// 'capacity' is the size of the fixed capacity for STATIC and FIXED storages and of the chunks for SEGMENTED
+	// storage. For VARIABLE storage 'capacity' is the initial capacity when allocation first occurs.
 	// (Initially-empty containers have no capacity.) For BUFFERED storage 'capacity' is the size
 	// of the small object optimization buffer (SBO). 'capacity' must be greater than 0.
 
 	size_t capacity = 1;
 
+	// 'reservation' is the maximum capacity (in elements) for RESERVED storage. The reservation is rounded up to
+	// whole pages. This must be greater than 0 (and at least 'capacity') for RESERVED storage.
+
+	size_t reservation = 0;
+
+	// 'huge_pages' requests huge pages for RESERVED storage where the system supports them for incrementally
+	// committed memory (transparent huge pages on Linux). This reduces TLB misses when iterating large sequences.
+
+	bool huge_pages = false;
+
+	// 'block_cache' keeps freed FIXED storage blocks for reuse, so that sequences which are filled and cleared over
+	// and over do not allocate each time. Each thread keeps up to this many blocks, and hands a batch of them to
+	// a shared cache when it has more (so blocks freed on one thread are reused by the threads which allocate).
+	// The allocator must be always equal and default constructible, since a block may be freed by any sequence
+	// of the type on any thread. The default (0) allocates and deallocates every block. (Blocks smaller than a
+	// pointer are not cached.)
+
+	size_t block_cache = 0;
+
+	// 'alignment' over-aligns the capacity to the given number of bytes, which must be 0 (the natural alignment of
+	// the elements) or a power of 2. For MIDDLE location, the free space in front of the data is rounded so that the
+	// data starts on the alignment when the elements are placed (when the capacity is allocated, reallocated,
+	// cleared or recentered), as long as the alignment is a multiple of the element size. For FRONT location the
+	// data always starts on the alignment. (For BACK location the data ends at the end of the capacity.) Aligning
+	// STATIC or BUFFERED storage to the cache line size also keeps sequences from sharing cache lines.
+
+	size_t alignment = 0;
+
 	// 'increment' specifies the linear capacity growth in elements. This must be greater than 0.
 
 	size_t increment = 1;
@@ -93,10 +158,91 @@ struct sequence_traits
 
 	float factor = 1.5;
 
+	// 'growth_function' specifies the capacity growth for CUSTOM growth. It is passed the current capacity and
+	// returns the new capacity, which must be larger. (A captureless lambda may be used.) It is not called to
+	// obtain the initial capacity (see 'capacity'). This must not be null for CUSTOM growth.
+
+	size_t (*growth_function)(size_t cap) = nullptr;
+
+	// 'migration_step' enables incremental reallocation for VARIABLE storage with FRONT location. When push_back
+	// outgrows the capacity, the new capacity is allocated but the elements are left in the old one, and each
+	// push_back and pop_back then moves up to this many of them into the new one. So push_back never moves more than
+	// 'migration_step' elements, as long as each migration finishes before the next growth (which requires a step
+	// of at least 1 / (factor - 1); 2 for VECTOR growth). Until a migration finishes, both capacities are held and
+	// element access chooses between them, so the iterators are not pointers. During a migration each push_back and
+	// pop_back invalidates the iterators and references (and the other modifications finish the migration). The
+	// default (0) moves all of the elements when the capacity grows. This is not available for LEARNED growth.
+
+	size_t migration_step = 0;
+
+	// 'recenter_fill' applies to MIDDLE location with dynamically allocated (VARIABLE or BUFFERED) storage. When the
+	// data reaches an end of the capacity, the elements are recentered if the capacity is no fuller than this
+	// fraction. Otherwise the capacity grows instead. (A nearly full sequence would otherwise recenter every few
+	// insertions.) This must be between 0.0 and 1.0. The default (1.0) always recenters (as long as there is room).
+
+	float recenter_fill = 1.0;
+
+	// 'shrink_fill' gives capacity back as dynamically sized (VARIABLE, BUFFERED, RESERVED or SEGMENTED) sequences
+	// shrink. When a removal leaves the sequence filled less than this fraction of its capacity, the capacity is
+	// reduced to twice the size (but not below 'capacity'). This must be less than 0.5, so that a sequence which
+	// has just been shrunk is not shrunk again at once. The default (0.0) never shrinks the capacity.
+
+	float shrink_fill = 0.0;
+
+	// 'front_bias' is the fraction of the free space which is placed in front of the data for MIDDLE location
+	// (when the capacity is allocated, reallocated, cleared or recentered). The default (0.5) centers the data.
+	// A sequence which grows mostly at the back should use a smaller value, one which grows mostly at the front
+	// a larger value. This must be between 0.0 and 1.0.
+
+	float front_bias = 0.5;
+
+	// 'adaptive_bias' applies to MIDDLE location with dynamically allocated (VARIABLE or BUFFERED) storage. If true,
+	// each sequence counts its insertions at the front and at the back and uses the observed ratio in place of
+	// 'front_bias' (which is still used until there have been any insertions). This adds two counters to the sequence.
+
+	bool adaptive_bias = false;
+
+	// 'discard' selects when the elements which a sequence discards are destroyed:
+	//
+	// EAGER	The elements are destroyed when they are discarded (like std::vector). This is the default.
+	//
+	// LAZY		A move assignment which takes over the capacity of the other sequence gives it the replaced elements
+	//			(and their capacity) instead of destroying them. They are destroyed when the moved-from sequence
+	//			is destroyed, cleared or assigned, which may be much later (or on another thread). This has no
+	//			effect for STATIC storage, whose elements are moved one at a time.
+	//
+	// DEFERRED	The elements replaced by a move assignment, cleared, or held by a sequence when it is destroyed are
+	//			queued (with their capacity) for sequence::reclaim, which destroys them. A background thread
+	//			which calls reclaim takes the destructor loops off the threads which use the sequences. Since
+	//			clearing gives up the capacity, a cleared sequence allocates again when elements are added.
+	//			Sequences of trivially destructible elements discard them as for EAGER, since there is no
+	//			destructor loop to defer. If the queue cannot take the elements, they are destroyed at once.
+	//			This is not available for STATIC storage.
+
+	sequence_discard_lits discard = sequence_discard_lits::EAGER;
+
+	// 'statistics' enables counting of capacity reallocations, bytes allocated, recenters, BUFFERED spills and
+	// rebuffers, and element moves caused by insertions. The counts are kept per sequence type and are returned
+	// by sequence::statistics. When false (the default), the counting compiles to nothing.
+
+	bool statistics = false;
+
+	// 'learned_percentile' applies to LEARNED growth. Each sequence records the largest size it reached in a
+	// histogram for its type when it is destroyed, and the first dynamic allocation is the capacity which would have
+	// held this fraction of the recorded sequences (rounded up to a power of 2). Until any sequences have been
+	// recorded, 'capacity' is used. This must be between 0.0 and 1.0.
+
+	float learned_percentile = 0.9;
+
+	// 'tag' distinguishes traits which are otherwise identical. The statistics and the learned capacity are kept
+	// per sequence type, so giving the sequences at a call site their own tag keeps their counts separate.
+
+	size_t tag = 0;
+
 	// 'grow' returns a new (larger) capacity given the current capacity. The calculation is based
 	// on the sequence_traits members which control capacity.
 
-	size_t grow(size_t cap) const
+	constexpr size_t grow(size_t cap) const
 	{
 		if (cap < capacity) return capacity;
 		switch (growth)
@@ -105,27 +251,53 @@ struct sequence_traits
 				return cap + increment;
 			case sequence_growth_lits::EXPONENTIAL:
 				return cap + std::max(size_t(cap * (factor - 1.f)), increment);
+			case sequence_growth_lits::CUSTOM:
+				return growth_function(cap);
 			default:
 			case sequence_growth_lits::VECTOR:
+			case sequence_growth_lits::LEARNED:
 				return cap + std::max<size_t>(cap / 2, 1u);
 		}
 	};
 
 	// 'front_gap' returns the location of the start of the data given a capacity and size.
-	// The formula is based on the 'location' value.
+	// The formula is based on the 'location' value (and 'front_bias' for MIDDLE location).
 
-	size_t front_gap(size_t cap, size_t size) const
+	constexpr size_t front_gap(size_t cap, size_t size) const
 	{
 		switch (location)
 		{
 		default:
-		case sequence_location_lits::FRONT:		return 0;
+		case sequence_location_lits::FRONT:
+		case sequence_location_lits::CIRCULAR:	return 0;
 		case sequence_location_lits::BACK:		return cap - size;
-		case sequence_location_lits::MIDDLE:	return (cap - size) / 2;
+		case sequence_location_lits::MIDDLE:	return size_t((cap - size) * double(front_bias));
 		}
 	}
-	size_t front_gap(size_t size = 0) const
+	constexpr size_t front_gap(size_t size = 0) const
 	{
 		return front_gap(capacity, size);
 	}
 };
+
+// capacity_alignment - The alignment of the capacity for a sequence type (see sequence_traits::alignment).
+// capacity_granule - The number of elements in the alignment, by which MIDDLE location front gaps are rounded.
+// (There is no rounding if the alignment is not a multiple of the element size.)
+
+template<typename T, sequence_traits TRAITS>
+constexpr size_t capacity_alignment = std::max(TRAITS.alignment, alignof(T));
+
+template<typename T, sequence_traits TRAITS>
+constexpr size_t capacity_granule = capacity_alignment<T, TRAITS> % sizeof(T) == 0 ?
+									capacity_alignment<T, TRAITS> / sizeof(T) : 1;
+
+// fixed_size_type - The type of the size (and gap) fields of fixed capacity storage. This is the smallest unsigned
+// type which can represent the fixed capacity (which is never wider than 'size_type', since 'size_type' must be able
+// to represent it). So the fields of small fixed sequences do not widen the object even with the default 'size_type'
+// (sequence<std::uint32_t, {.storage = STATIC, .capacity = 3}> is 16 bytes rather than 24, for instance).
+
+template<sequence_traits TRAITS>
+using fixed_size_type = std::conditional_t<(TRAITS.capacity <= std::numeric_limits<std::uint8_t>::max()), std::uint8_t,
+						std::conditional_t<(TRAITS.capacity <= std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+						std::conditional_t<(TRAITS.capacity <= std::numeric_limits<std::uint32_t>::max()), std::uint32_t,
+						size_t>>>;
@@ -7,56 +7,637 @@ import <assert.h>;
 // ==============================================================================================================
 // Utility functions
 
+// The points_into function returns true if the pointer refers to an element in the
+// data range. Such an argument would be invalidated by shifting or reallocation. (In
+// constant evaluation, where unrelated pointers cannot be ordered, the elements are
+// compared one at a time.)
+
+template<typename T>
+constexpr bool points_into(const T* p, const T* data_begin, const T* data_end)
+{
+	if consteval
+	{
+		for (; data_begin != data_end; ++data_begin)
+			if (data_begin == p)
+				return true;
+		return false;
+	}
+	return !std::less<const T*>()(p, data_begin) && std::less<const T*>()(p, data_end);
+}
+
+// The constructible_in_gap function returns true if an element can be constructed from 'args' directly in the
+// gap opened by shifting the elements [begin, end). That is the case if each argument is an element or a scalar
+// (which cannot refer to the elements indirectly) and none of the arguments lie within the shifted elements.
+// Otherwise the element must first be constructed as a temporary. (In constant evaluation only element arguments
+// can be compared with the shifted elements, so a temporary is used for any others.)
+
+template<typename T, typename... ARGS>
+constexpr bool constructible_in_gap(const T* begin, const T* end, const ARGS&... args)
+{
+	if consteval
+	{
+		if constexpr ((std::same_as<std::remove_cv_t<ARGS>, T> && ...))
+			return !(points_into(std::addressof(args), begin, end) || ...);
+		else
+			return false;
+	}
+	if constexpr (((std::same_as<std::remove_cv_t<ARGS>, T> || std::is_arithmetic_v<ARGS> || std::is_enum_v<ARGS>) && ...))
+	{
+		auto first = reinterpret_cast<const std::byte*>(begin);
+		auto last = reinterpret_cast<const std::byte*>(end);
+		return !(points_into(reinterpret_cast<const std::byte*>(std::addressof(args)), first, last) || ...);
+	}
+	else
+		return false;
+}
+
+// The destroy_data function encapsulates calling the element destructors. It is called
+// in the sequence destructor and elsewhere when elements are either going away or have
+// been moved somewhere else. It does nothing for trivially destructible elements. (The
+// range may be given by pointers or by circular_iterators.)
+
+template<typename ITER>
+constexpr void destroy_data(ITER data_begin, ITER data_end)
+{
+	if constexpr (!std::is_trivially_destructible_v<std::iter_value_t<ITER>>)
+		std::destroy(data_begin, data_end);
+}
+
+// The copy_data and move_data functions copy or move construct the elements of a range into uninitialized memory
+// and return the end of the new elements. They are the standard uninitialized algorithms, except that in constant
+// evaluation (where those are not constexpr) the elements are constructed one at a time with std::construct_at.
+// If a constructor throws, the elements already constructed are destroyed.
+
+template<typename ITER, typename OUT>
+constexpr OUT copy_data(ITER first, ITER last, OUT dst)
+{
+	if consteval
+	{
+		auto out = dst;
+		try
+		{
+			for (; first != last; ++first, ++out)
+				std::construct_at(std::addressof(*out), *first);
+		}
+		catch (...)
+		{
+			destroy_data(dst, out);
+			throw;
+		}
+		return out;
+	}
+	return std::uninitialized_copy(first, last, dst);
+}
+template<typename ITER, typename OUT>
+constexpr OUT copy_data_n(ITER first, size_t count, OUT dst)
+{
+	if consteval
+	{
+		auto out = dst;
+		try
+		{
+			for (; count; --count, ++first, ++out)
+				std::construct_at(std::addressof(*out), *first);
+		}
+		catch (...)
+		{
+			destroy_data(dst, out);
+			throw;
+		}
+		return out;
+	}
+	return std::uninitialized_copy_n(first, count, dst);
+}
+template<typename ITER, typename OUT>
+constexpr OUT move_data(ITER first, ITER last, OUT dst)
+{
+	if consteval
+	{
+		return copy_data(std::make_move_iterator(first), std::make_move_iterator(last), dst);
+	}
+	return std::uninitialized_move(first, last, dst);
+}
+
+// The relocate function moves the elements in a range to uninitialized memory and ends the lifetimes of the
+// originals. For trivially relocatable types this is a single memmove, so the ranges may overlap. Otherwise
+// the ranges must not overlap. (In constant evaluation the elements are moved one at a time.)
+
+template<typename T>
+constexpr void relocate(T* begin, T* end, T* dst)
+{
+	if (begin == end || begin == dst)
+		return;
+	if consteval
+	{
+		// The ranges may overlap (see above), so the elements are moved in the direction which is safe. (The
+		// ranges may also be in different allocations, which cannot be ordered, so only equality is compared.)
+		if (!points_into<T>(dst, begin, end))
+			for (; begin != end; ++begin, ++dst)
+			{
+				std::construct_at(dst, std::move(*begin));
+				std::destroy_at(begin);
+			}
+		else
+			for (dst += end - begin; begin != end; )
+			{
+				std::construct_at(--dst, std::move(*--end));
+				std::destroy_at(end);
+			}
+		return;
+	}
+	if constexpr (sequence_trivially_relocatable<T>)
+		std::memmove(static_cast<void*>(dst), static_cast<const void*>(begin), (end - begin) * sizeof(T));
+	else
+	{
+		move_data(begin, end, dst);
+		destroy_data(begin, end);
+	}
+}
+
 // The add functions implement the algorithms for adding an element at the front
-// or back. These algorithms are used for both fixed and dynamic storage.
+// or back. These algorithms are used for both fixed and dynamic storage. The gap is opened
+// first and the element is constructed in it (or, if the elements cannot be trivially relocated,
+// assigned to it from an element argument), unless the arguments require a temporary (see
+// constructible_in_gap). Trivially relocated elements are moved back if the construction throws.
 
 template<typename T, std::regular_invocable FUNC, typename... ARGS>
-T* back_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
-{
-	T temp(std::forward<ARGS>(args)...);
-	new(dst) T(std::move(*(dst - 1)));
-	adjust();
-	for (auto src = --dst - 1; dst != pos;)
-		*dst-- = std::move(*src--);
-	*pos = std::move(temp);
-	return pos;
+constexpr T* back_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
+{
+	constexpr bool assignable = sizeof...(ARGS) == 1 && (std::same_as<std::remove_cvref_t<ARGS>, T> && ...);
+
+	if constexpr (!sequence_trivially_relocatable<T> && !assignable)
+		return back_add_at(dst, pos, adjust, T(std::forward<ARGS>(args)...));
+	else
+	{
+		if (!constructible_in_gap<T>(pos, dst, args...))
+			return back_add_at(dst, pos, adjust, T(std::forward<ARGS>(args)...));
+		if constexpr (sequence_trivially_relocatable<T>)
+		{
+			relocate(pos, dst, pos + 1);
+			try
+			{
+				std::construct_at(pos, std::forward<ARGS>(args)...);
+			}
+			catch (...)
+			{
+				relocate(pos + 1, dst + 1, pos);
+				throw;
+			}
+			adjust();
+		}
+		else
+		{
+			std::construct_at(dst, std::move(*(dst - 1)));
+			adjust();
+			std::move_backward(pos, dst - 1, dst);
+			((*pos = std::forward<ARGS>(args)), ...);
+		}
+		return pos;
+	}
 }
 
 template<typename T, std::regular_invocable FUNC, typename... ARGS>
-T* front_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
-{
-	T temp(std::forward<ARGS>(args)...);
-	new(dst - 1) T(std::move(*dst));
-	adjust();
-	--pos;
-	for (auto src = dst + 1; dst != pos;)
-		*dst++ = std::move(*src++);
-	*pos = std::move(temp);
+constexpr T* front_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
+{
+	constexpr bool assignable = sizeof...(ARGS) == 1 && (std::same_as<std::remove_cvref_t<ARGS>, T> && ...);
+
+	if constexpr (!sequence_trivially_relocatable<T> && !assignable)
+		return front_add_at(dst, pos, adjust, T(std::forward<ARGS>(args)...));
+	else
+	{
+		if (!constructible_in_gap<T>(dst, pos, args...))
+			return front_add_at(dst, pos, adjust, T(std::forward<ARGS>(args)...));
+		if constexpr (sequence_trivially_relocatable<T>)
+		{
+			relocate(dst, pos, dst - 1);
+			try
+			{
+				std::construct_at(pos - 1, std::forward<ARGS>(args)...);
+			}
+			catch (...)
+			{
+				relocate(dst - 1, pos - 1, dst);
+				throw;
+			}
+			adjust();
+		}
+		else
+		{
+			std::construct_at(dst - 1, std::move(*dst));
+			adjust();
+			std::move(dst + 1, pos, dst);
+			((*(pos - 1) = std::forward<ARGS>(args)), ...);
+		}
+		return pos - 1;
+	}
+}
+
+// The add range functions implement the algorithms for inserting 'count' elements copied from
+// 'first' at 'pos' by shifting the elements after (back) or before (front) the position. The space
+// must already be available. Trivially relocatable elements are shifted with one memmove and the new
+// elements are constructed in the gap. Otherwise the new elements are constructed in the part of the gap
+// beyond the original data and assigned over the moved-from elements in the rest of the gap. The iterator
+// must be a forward iterator. The adjust function is passed the number of elements constructed (it may
+// be called more than once) and the position of the first new element is returned.
+
+template<typename T, typename ITER, std::regular_invocable<size_t> FUNC>
+constexpr T* back_add_range_at(T* data_end, T* pos, ITER first, size_t count, FUNC adjust)
+{
+	size_t tail = data_end - pos;
+
+	if (count == 0)
+		return pos;
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		relocate(pos, data_end, pos + count);
+		try
+		{
+			copy_data_n(first, count, pos);
+		}
+		catch (...)
+		{
+			relocate(pos + count, data_end + count, pos);
+			throw;
+		}
+		adjust(count);
+	}
+	else if (count <= tail)
+	{
+		move_data(data_end - count, data_end, data_end);
+		adjust(count);
+		std::move_backward(pos, data_end - count, data_end);
+		std::copy_n(first, count, pos);
+	}
+	else
+	{
+		copy_data_n(std::next(first, tail), count - tail, data_end);
+		adjust(count - tail);
+		move_data(pos, data_end, pos + count);
+		adjust(tail);
+		std::copy_n(first, tail, pos);
+	}
 	return pos;
 }
 
-// The destroy_data function encapsulates calling the element destructors. It is called
-// in the sequence destructor and elsewhere when elements are either going away or have
-// been moved somewhere else.
+template<typename T, typename ITER, std::regular_invocable<size_t> FUNC>
+constexpr T* front_add_range_at(T* data_begin, T* pos, ITER first, size_t count, FUNC adjust)
+{
+	size_t head = pos - data_begin;
+	auto new_pos = pos - count;
+
+	if (count == 0)
+		return pos;
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		relocate(data_begin, pos, data_begin - count);
+		try
+		{
+			copy_data_n(first, count, new_pos);
+		}
+		catch (...)
+		{
+			relocate(data_begin - count, new_pos, data_begin);
+			throw;
+		}
+		adjust(count);
+	}
+	else if (count <= head)
+	{
+		move_data(data_begin, data_begin + count, data_begin - count);
+		adjust(count);
+		std::move(data_begin + count, pos, data_begin);
+		std::copy_n(first, count, new_pos);
+	}
+	else
+	{
+		copy_data_n(first, count - head, new_pos);
+		adjust(count - head);
+		move_data(data_begin, pos, data_begin - count);
+		adjust(head);
+		std::copy_n(std::next(first, count - head), head, data_begin);
+	}
+	return new_pos;
+}
+
+// repeat_iterator - Forward iterator which refers to the same value at every position. It is used
+// to insert multiple copies of a value with the add range functions.
+
+template<typename T>
+class repeat_iterator
+{
+public:
+
+	using value_type = T;
+	using difference_type = std::ptrdiff_t;
+	using reference = const T&;
+	using pointer = const T*;
+	using iterator_category = std::forward_iterator_tag;
+
+	repeat_iterator() = default;
+	constexpr explicit repeat_iterator(const T& value, difference_type index = 0) : m_value(&value), m_index(index) {}
+
+	constexpr reference operator*() const { return *m_value; }
+	constexpr pointer operator->() const { return m_value; }
+	constexpr repeat_iterator& operator++() { ++m_index; return *this; }
+	constexpr repeat_iterator operator++(int) { auto temp = *this; ++m_index; return temp; }
+	bool operator==(const repeat_iterator& rhs) const { return m_index == rhs.m_index; }
+
+private:
+
+	const T* m_value = nullptr;
+	difference_type m_index = 0;
+};
+
+// circular_iterator - Random access iterator for CIRCULAR location, where the data wraps around the end of the
+// capacity. It holds the capacity, the offset of the first element within it, and the index of the element it
+// refers to, so that iterators into the same sequence are compared and subtracted by index. Dereferencing maps
+// the index onto the capacity with a compare rather than a division.
+
+template<typename T>
+class circular_iterator
+{
+public:
+
+	using value_type = std::remove_const_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using pointer = T*;
+	using iterator_category = std::random_access_iterator_tag;
+	using iterator_concept = std::random_access_iterator_tag;
+
+	circular_iterator() = default;
+	constexpr circular_iterator(T* capacity_begin, size_t capacity, size_t head, difference_type index) :
+		m_capacity_begin(capacity_begin), m_capacity(capacity), m_head(head), m_index(index) {}
+	constexpr operator circular_iterator<const T>() const requires (!std::is_const_v<T>)
+	{
+		return circular_iterator<const T>(m_capacity_begin, m_capacity, m_head, m_index);
+	}
+
+	constexpr reference operator*() const { return *address(); }
+	constexpr pointer operator->() const { return address(); }
+	constexpr reference operator[](difference_type n) const { return *(*this + n); }
+
+	constexpr circular_iterator& operator++() { ++m_index; return *this; }
+	constexpr circular_iterator operator++(int) { auto temp = *this; ++m_index; return temp; }
+	constexpr circular_iterator& operator--() { --m_index; return *this; }
+	constexpr circular_iterator operator--(int) { auto temp = *this; --m_index; return temp; }
+	constexpr circular_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+	constexpr circular_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+	friend constexpr circular_iterator operator+(circular_iterator i, difference_type n) { return i += n; }
+	friend constexpr circular_iterator operator+(difference_type n, circular_iterator i) { return i += n; }
+	friend constexpr circular_iterator operator-(circular_iterator i, difference_type n) { return i -= n; }
+	friend constexpr difference_type operator-(const circular_iterator& lhs, const circular_iterator& rhs) { return lhs.m_index - rhs.m_index; }
+	friend constexpr bool operator==(const circular_iterator& lhs, const circular_iterator& rhs) { return lhs.m_index == rhs.m_index; }
+	friend constexpr auto operator<=>(const circular_iterator& lhs, const circular_iterator& rhs) { return lhs.m_index <=> rhs.m_index; }
+
+	// The address function returns the address of the element in the capacity. (The index must be within
+	// the capacity.)
+
+	constexpr pointer address() const
+	{
+		size_t offset = m_head + size_t(m_index);
+		return m_capacity_begin + (offset < m_capacity ? offset : offset - m_capacity);
+	}
+
+private:
+
+	T* m_capacity_begin = nullptr;
+	size_t m_capacity = 0;
+	size_t m_head = 0;
+	difference_type m_index = 0;
+};
+
+// segmented_iterator - Random access iterator for SEGMENTED storage, where the data is held in chunks of CHUNK
+// elements listed in an index. It holds the first used entry of the index and the offset of the element it refers
+// to from the start of the first chunk, so that iterators into the same sequence are compared and subtracted by
+// offset. Dereferencing divides the offset by the chunk size (a shift if it is a power of 2).
+
+template<typename T, size_t CHUNK>
+class segmented_iterator
+{
+	using chunk_pointer = T* const*;
+
+public:
+
+	using value_type = std::remove_const_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using pointer = T*;
+	using iterator_category = std::random_access_iterator_tag;
+	using iterator_concept = std::random_access_iterator_tag;
+
+	segmented_iterator() = default;
+	constexpr segmented_iterator(chunk_pointer chunks, difference_type offset) : m_chunks(chunks), m_offset(offset) {}
+	constexpr operator segmented_iterator<const T, CHUNK>() const requires (!std::is_const_v<T>)
+	{
+		return segmented_iterator<const T, CHUNK>(m_chunks, m_offset);
+	}
+
+	constexpr reference operator*() const { return *address(); }
+	constexpr pointer operator->() const { return address(); }
+	constexpr reference operator[](difference_type n) const { return *(*this + n); }
+
+	constexpr segmented_iterator& operator++() { ++m_offset; return *this; }
+	constexpr segmented_iterator operator++(int) { auto temp = *this; ++m_offset; return temp; }
+	constexpr segmented_iterator& operator--() { --m_offset; return *this; }
+	constexpr segmented_iterator operator--(int) { auto temp = *this; --m_offset; return temp; }
+	constexpr segmented_iterator& operator+=(difference_type n) { m_offset += n; return *this; }
+	constexpr segmented_iterator& operator-=(difference_type n) { m_offset -= n; return *this; }
+
+	friend constexpr segmented_iterator operator+(segmented_iterator i, difference_type n) { return i += n; }
+	friend constexpr segmented_iterator operator+(difference_type n, segmented_iterator i) { return i += n; }
+	friend constexpr segmented_iterator operator-(segmented_iterator i, difference_type n) { return i -= n; }
+	friend constexpr difference_type operator-(const segmented_iterator& lhs, const segmented_iterator& rhs) { return lhs.m_offset - rhs.m_offset; }
+	friend constexpr bool operator==(const segmented_iterator& lhs, const segmented_iterator& rhs) { return lhs.m_offset == rhs.m_offset; }
+	friend constexpr auto operator<=>(const segmented_iterator& lhs, const segmented_iterator& rhs) { return lhs.m_offset <=> rhs.m_offset; }
+
+	// The address function returns the address of the element in its chunk. (The offset must be within the
+	// chunks.)
+
+	constexpr pointer address() const
+	{
+		return m_chunks[size_t(m_offset) / CHUNK] + size_t(m_offset) % CHUNK;
+	}
+
+	// The offset function returns the offset of the element from the start of the first chunk.
+
+	constexpr size_t offset() const { return size_t(m_offset); }
+
+private:
+
+	chunk_pointer m_chunks = nullptr;
+	difference_type m_offset = 0;
+};
+
+// migrating_iterator - Random access iterator for incremental reallocation (see sequence_traits::migration_step),
+// where the elements [lo, hi) may still be in the old capacity while the others are in the new one. It holds both
+// capacities and the range still to be moved, and an element is fetched from the old capacity if its index is in
+// that range (which is empty once the elements have all been moved).
 
 template<typename T>
-void destroy_data(T* data_begin, T* data_end)
+class migrating_iterator
+{
+public:
+
+	using value_type = std::remove_const_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using pointer = T*;
+	using iterator_category = std::random_access_iterator_tag;
+	using iterator_concept = std::random_access_iterator_tag;
+
+	migrating_iterator() = default;
+	constexpr migrating_iterator(T* data, T* old_data, size_t lo, size_t hi, difference_type index) :
+		m_data(data), m_old_data(old_data), m_lo(lo), m_hi(hi), m_index(index) {}
+	constexpr operator migrating_iterator<const T>() const requires (!std::is_const_v<T>)
+	{
+		return migrating_iterator<const T>(m_data, m_old_data, m_lo, m_hi, m_index);
+	}
+
+	constexpr reference operator*() const { return *address(); }
+	constexpr pointer operator->() const { return address(); }
+	constexpr reference operator[](difference_type n) const { return *(*this + n); }
+
+	constexpr migrating_iterator& operator++() { ++m_index; return *this; }
+	constexpr migrating_iterator operator++(int) { auto temp = *this; ++m_index; return temp; }
+	constexpr migrating_iterator& operator--() { --m_index; return *this; }
+	constexpr migrating_iterator operator--(int) { auto temp = *this; --m_index; return temp; }
+	constexpr migrating_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+	constexpr migrating_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+	friend constexpr migrating_iterator operator+(migrating_iterator i, difference_type n) { return i += n; }
+	friend constexpr migrating_iterator operator+(difference_type n, migrating_iterator i) { return i += n; }
+	friend constexpr migrating_iterator operator-(migrating_iterator i, difference_type n) { return i -= n; }
+	friend constexpr difference_type operator-(const migrating_iterator& lhs, const migrating_iterator& rhs) { return lhs.m_index - rhs.m_index; }
+	friend constexpr bool operator==(const migrating_iterator& lhs, const migrating_iterator& rhs) { return lhs.m_index == rhs.m_index; }
+	friend constexpr auto operator<=>(const migrating_iterator& lhs, const migrating_iterator& rhs) { return lhs.m_index <=> rhs.m_index; }
+
+	// The address function returns the address of the element in whichever capacity holds it. (The range is
+	// tested with one unsigned comparison.)
+
+	constexpr pointer address() const
+	{
+		return (size_t(m_index) - m_lo < m_hi - m_lo ? m_old_data : m_data) + m_index;
+	}
+
+private:
+
+	T* m_data = nullptr;
+	T* m_old_data = nullptr;
+	size_t m_lo = 0;
+	size_t m_hi = 0;
+	difference_type m_index = 0;
+};
+
+// default_construct - Tag passed as the argument to the add count functions (see construct_data) to default
+// initialize the new elements rather than value initializing them (see sequence::resize_for_overwrite).
+
+struct default_construct_t {};
+constexpr default_construct_t default_construct;
+
+// The construct_data function constructs 'count' elements at 'dst' from 'args', which are not forwarded
+// since they are used for every element. With no arguments the elements are value initialized, and with the
+// default_construct tag they are default initialized. A single element argument is copied. These use the
+// standard uninitialized algorithms, which reduce to memset or memcpy for trivial types. If a constructor
+// throws, the elements already constructed are destroyed.
+
+template<typename T, typename... ARGS>
+constexpr void construct_data(T* dst, size_t count, ARGS&&... args)
 {
-	for (auto&& element : span<T>(data_begin, data_end))
-		element.~T();
+	if consteval
+	{
+		// Default initialized elements would be unusable in constant evaluation, so they are value initialized.
+		auto p = dst;
+		try
+		{
+			for (auto end = dst + count; p != end; ++p)
+				if constexpr ((std::same_as<std::remove_cvref_t<ARGS>, default_construct_t> && ...))
+					std::construct_at(p);
+				else
+					std::construct_at(p, args...);
+		}
+		catch (...)
+		{
+			destroy_data(dst, p);
+			throw;
+		}
+		return;
+	}
+	if constexpr (sizeof...(ARGS) == 0)
+		std::uninitialized_value_construct_n(dst, count);
+	else if constexpr ((std::same_as<std::remove_cvref_t<ARGS>, default_construct_t> && ...))
+		std::uninitialized_default_construct_n(dst, count);
+	else if constexpr (sizeof...(ARGS) == 1 && (std::same_as<std::remove_cvref_t<ARGS>, T> && ...))
+		std::uninitialized_fill_n(dst, count, args...);
+	else
+	{
+		auto p = dst;
+		try
+		{
+			for (auto end = dst + count; p != end; ++p)
+				std::construct_at(p, args...);
+		}
+		catch (...)
+		{
+			destroy_data(dst, p);
+			throw;
+		}
+	}
+}
+
+// The front_add_n function adds 'count' elements constructed from 'args' (see construct_data) at the back of
+// data which has room only at the front, by moving the elements 'count' places toward the front. Trivially
+// relocatable elements are moved with one memmove and the new elements are constructed in the vacated space.
+// Otherwise the new elements are constructed in front of the data and rotated to the back. The adjust function
+// is passed the number of elements added.
+
+template<typename T, std::regular_invocable<size_t> FUNC, typename... ARGS>
+constexpr void front_add_n(T* data_begin, T* data_end, size_t count, FUNC adjust, ARGS&&... args)
+{
+	if (count == 0)
+		return;
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		relocate(data_begin, data_end, data_begin - count);
+		try
+		{
+			construct_data(data_end - count, count, args...);
+		}
+		catch (...)
+		{
+			relocate(data_begin - count, data_end - count, data_begin);
+			throw;
+		}
+		adjust(count);
+	}
+	else
+	{
+		construct_data(data_begin - count, count, args...);
+		adjust(count);
+		std::rotate(data_begin - count, data_begin, data_end);
+	}
 }
 
 // The erase functions implement the erase element and erase range algorithms for front
 // and back erasure. These algorithms are used for both fixed and dynamic storage.
 
 template<typename T, std::regular_invocable<size_t> FUNC>
-void front_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC adjust)
+constexpr void front_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC adjust)
 {
 	assert(erase_begin >= data_begin);
 	assert(erase_end <= data_end);
 	assert(erase_end >= erase_begin);
 
-	if (erase_begin != erase_end)
+	if (erase_begin == erase_end)
+		return;
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		destroy_data(erase_begin, erase_end);
+		relocate(data_begin, erase_begin, data_begin + (erase_end - erase_begin));
+		adjust(erase_end - erase_begin);
+	}
+	else
 	{
 		auto beg = data_begin - 1;
 		auto dst = erase_end - 1;
@@ -69,25 +650,42 @@ void front_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC
 }
 
 template<typename T, std::regular_invocable FUNC>
-void front_erase(T* data_begin, T* data_end, T* dst, FUNC adjust)
+constexpr void front_erase(T* data_begin, T* data_end, T* dst, FUNC adjust)
 {
 	assert(dst >= data_begin && dst < data_end);
 
-	auto src = dst - 1;
-	while (dst != data_begin)
-		*dst-- = std::move(*src--);
-	adjust();
-	dst->~T();
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		dst->~T();
+		relocate(data_begin, dst, data_begin + 1);
+		adjust();
+	}
+	else
+	{
+		auto src = dst - 1;
+		while (dst != data_begin)
+			*dst-- = std::move(*src--);
+		adjust();
+		dst->~T();
+	}
 }
 
 template<typename T, std::regular_invocable<size_t> FUNC>
-void back_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC adjust)
+constexpr void back_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC adjust)
 {
 	assert(erase_begin >= data_begin);
 	assert(erase_end <= data_end);
 	assert(erase_end >= erase_begin);
 
-	if (erase_begin != erase_end)
+	if (erase_begin == erase_end)
+		return;
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		destroy_data(erase_begin, erase_end);
+		relocate(erase_end, data_end, erase_begin);
+		adjust(erase_end - erase_begin);
+	}
+	else
 	{
 		auto dst = erase_begin;
 		auto src = erase_end;
@@ -99,42 +697,219 @@ void back_erase(T* data_begin, T* data_end, T* erase_begin, T* erase_end, FUNC a
 }
 
 template<typename T, std::regular_invocable FUNC>
-void back_erase(T* data_begin, T* data_end, T* dst, FUNC adjust)
+constexpr void back_erase(T* data_begin, T* data_end, T* dst, FUNC adjust)
 {
 	assert(dst >= data_begin && dst < data_end);
 
-	auto src = dst + 1;
-	while (src != data_end)
-		*dst++ = std::move(*src++);
-	adjust();
-	dst->~T();
+	if constexpr (sequence_trivially_relocatable<T>)
+	{
+		dst->~T();
+		relocate(dst + 1, data_end, dst);
+		adjust();
+	}
+	else
+	{
+		auto src = dst + 1;
+		while (src != data_end)
+			*dst++ = std::move(*src++);
+		adjust();
+		dst->~T();
+	}
+}
+
+// The shift function moves the elements [data_begin, data_end) within a capacity so that they start at 'dst'.
+// The ranges may overlap. Elements are move constructed into unoccupied locations and move assigned into
+// occupied ones, working from the leading end so that no element is overwritten before it has been moved.
+// The vacated elements are then destroyed.
+
+template<typename T>
+constexpr void shift(T* data_begin, T* data_end, T* dst)
+{
+	auto dst_end = dst + (data_end - data_begin);
+
+	if (dst < data_begin)
+	{
+		auto src = data_begin;
+		auto out = dst;
+		for (; out != data_begin && out != dst_end; ++out, ++src)
+			std::construct_at(out, std::move(*src));
+		for (; out != dst_end; ++out, ++src)
+			*out = std::move(*src);
+		destroy_data(std::max(dst_end, data_begin), data_end);
+	}
+	else if (dst > data_begin)
+	{
+		auto src = data_end;
+		auto out = dst_end;
+		while (out != data_end && out != dst)
+			std::construct_at(--out, std::move(*--src));
+		while (out != dst)
+			*--out = std::move(*--src);
+		destroy_data(data_begin, std::min(dst, data_end));
+	}
 }
 
-// The recenter function shifts the elements in a MIDDLE location capacity to prepare for size growth.
-// If the remaining space is odd, then the extra space will be at the front if we are making space at
-// the front, otherwise it will be at the back. It returns the new front and back gaps.
+// The reposition function moves the elements in a capacity so that they start 'front_gap' elements
+// from the beginning of the capacity. Trivially relocatable elements are shifted in place by memmove
+// and move assignable elements by an ordered shift. Otherwise they are moved out to a temporary capacity
+// and back again. Any additional arguments (such as an allocator) are passed to the constructor of the
+// temporary capacity.
 
-template<typename CAPACITY, typename T>
-std::pair<size_t, size_t> recenter(T* capacity_begin, T* capacity_end, T* data_begin, T* data_end)
+template<typename CAPACITY, typename T, typename... ARGS>
+constexpr void reposition(T* capacity_begin, T* data_begin, T* data_end, size_t front_gap, ARGS&&... args)
 {
-	assert(data_begin == capacity_begin || data_end == capacity_end);
+	auto size = data_end - data_begin;
+
+	if (data_begin == capacity_begin + front_gap)
+		return;
+	if constexpr (sequence_trivially_relocatable<T>)
+		relocate(data_begin, data_end, capacity_begin + front_gap);
+	else if constexpr (std::is_move_assignable_v<T>)
+		shift(data_begin, data_end, capacity_begin + front_gap);
+	else
+	{
+		CAPACITY temp(size, std::forward<ARGS>(args)...);
+		relocate(data_begin, data_end, temp.capacity_begin());
+		relocate(temp.capacity_begin(), temp.capacity_begin() + size, capacity_begin + front_gap);
+	}
+}
+
+// The recenter function shifts the elements in a MIDDLE location capacity to prepare for size growth at the
+// front (if 'at_front') or at the back. The free space is divided according to 'front_bias' (the fraction to
+// place at the front), rounding in favor of the end being grown, and that end always gets at least one
+// element of space. (So with a bias of 0.5, if the remaining space is odd, then the extra space will be at
+// the front if we are making space at the front, otherwise it will be at the back.) It returns the new front
+// and back gaps. The front gap is rounded down to a multiple of 'granule' elements (see aligned_front_gap) unless
+// that would leave no room at the front. Any additional arguments are passed to reposition.
+
+template<typename CAPACITY, typename T, typename... ARGS>
+constexpr std::pair<size_t, size_t> recenter(T* capacity_begin, T* capacity_end, T* data_begin, T* data_end,
+								   bool at_front, double front_bias, size_t granule, ARGS&&... args)
+{
+	assert(at_front ? data_begin == capacity_begin : data_end == capacity_end);
 	assert(data_begin != capacity_begin || data_end != capacity_end);
 
-	auto capacity = capacity_end - capacity_begin;
-	auto size = data_end - data_begin;
+	size_t free = (capacity_end - capacity_begin) - (data_end - data_begin);
 
-	CAPACITY temp(size);
-	std::uninitialized_move(data_begin, data_end, temp.capacity_begin());
-	destroy_data(data_begin, data_end);
+	auto scaled = free * front_bias;
+	auto fg = at_front ? std::clamp(size_t(scaled) + (size_t(scaled) < scaled), size_t(1), free)
+					   : std::clamp(size_t(free * front_bias), size_t(0), free - 1);
+	if (auto aligned = fg / granule * granule; aligned >= size_t(at_front))
+		fg = aligned;
+	auto bg = free - fg;
 
-	auto fg = sequence_traits{.location = sequence_location_lits::MIDDLE}.front_gap(capacity, size);
-	auto bg = capacity - (fg + size);
-	if (data_begin == capacity_begin) std::swap(fg, bg);
-	std::uninitialized_move(temp.capacity_begin(), temp.capacity_begin() + size, capacity_begin + fg);
+	reposition<CAPACITY>(capacity_begin, data_begin, data_end, fg, std::forward<ARGS>(args)...);
 
 	return {fg, bg};
 }
 
+// The aligned_front_gap function returns the front gap for the location (see sequence_traits::front_gap). For
+// MIDDLE location it is rounded down to a multiple of the capacity granule, so that the data starts on the
+// capacity alignment (see sequence_traits::alignment).
+
+template<typename T, sequence_traits TRAITS>
+constexpr size_t aligned_front_gap(size_t cap, size_t size)
+{
+	auto gap = TRAITS.front_gap(cap, size);
+	if constexpr (TRAITS.location == sequence_location_lits::MIDDLE)
+		gap = gap / capacity_granule<T, TRAITS> * capacity_granule<T, TRAITS>;
+	return gap;
+}
+
+// insertion_bias - Base class for MIDDLE location storage which supplies the front bias (see sequence_traits).
+// When 'adaptive_bias' is set, it counts the insertions at each end and the bias follows the observed ratio.
+// Both counts are halved periodically so that the bias follows changes in the workload.
+
+template<typename T, sequence_traits TRAITS, bool ADAPTIVE = TRAITS.adaptive_bias>
+class insertion_bias
+{
+protected:
+
+	constexpr void count_front() {}
+	constexpr void count_back() {}
+
+	constexpr double front_bias() const { return TRAITS.front_bias; }
+	constexpr size_t biased_front_gap(size_t cap, size_t size) const { return aligned_front_gap<T, TRAITS>(cap, size); }
+};
+
+template<typename T, sequence_traits TRAITS>
+class insertion_bias<T, TRAITS, true>
+{
+protected:
+
+	constexpr void count_front() { count(m_front_count); }
+	constexpr void count_back() { count(m_back_count); }
+
+	constexpr double front_bias() const
+	{
+		auto total = m_front_count + m_back_count;
+		return total ? double(m_front_count) / total : TRAITS.front_bias;
+	}
+	constexpr size_t biased_front_gap(size_t cap, size_t size) const
+	{
+		return size_t((cap - size) * front_bias()) / capacity_granule<T, TRAITS> * capacity_granule<T, TRAITS>;
+	}
+
+private:
+
+	constexpr void count(std::uint32_t& counter)
+	{
+		if (++counter == COUNT_LIMIT)
+		{
+			m_front_count /= 2;
+			m_back_count /= 2;
+		}
+	}
+
+	constexpr static std::uint32_t COUNT_LIMIT = 1024;
+
+	std::uint32_t m_front_count = 0;
+	std::uint32_t m_back_count = 0;
+};
+
+
+// The assign_elements function makes the elements of 'lhs' copies of those of 'rhs', whose size must be no more
+// than the capacity of 'lhs'. The elements which are already there are assigned to, and only the difference in
+// size is constructed or destroyed, so no element is destroyed just to be constructed again. (For BACK location
+// the elements are matched from the back, where they are kept, and the difference is at the front.) Elements
+// which cannot be copy assigned are all destroyed and constructed again.
+
+template<sequence_location_lits LOC, typename STORAGE>
+constexpr void assign_elements(STORAGE& lhs, const STORAGE& rhs)
+{
+	assert(rhs.size() <= lhs.capacity());
+
+	if (&lhs == &rhs)
+		return;
+	if constexpr (!std::is_copy_assignable_v<std::remove_cvref_t<decltype(*lhs.data_begin())>>)
+	{
+		lhs.clear();
+		lhs.add_range_at(lhs.data_begin(), rhs.data_begin(), rhs.size());
+	}
+	else
+	{
+		size_t size = lhs.size();
+		size_t rhs_size = rhs.size();
+		size_t common = std::min(size, rhs_size);
+
+		if constexpr (LOC == sequence_location_lits::BACK)
+		{
+			std::copy(rhs.data_end() - common, rhs.data_end(), lhs.data_end() - common);
+			if (rhs_size > size)
+				lhs.add_range_at(lhs.data_begin(), rhs.data_begin(), rhs_size - size);
+			else if (size > rhs_size)
+				lhs.erase(lhs.data_begin(), lhs.data_begin() + (size - rhs_size));
+		}
+		else
+		{
+			std::copy(rhs.data_begin(), rhs.data_begin() + common, lhs.data_begin());
+			if (rhs_size > size)
+				lhs.add_range_at(lhs.data_end(), rhs.data_begin() + common, rhs_size - size);
+			else if (size > rhs_size)
+				lhs.erase(lhs.data_begin() + rhs_size, lhs.data_end());
+		}
+	}
+}
 
 // ==============================================================================================================
 // Concepts
@@ -148,3 +923,9 @@ concept sequence_storage_implementation = requires(T& t)
     t.data_end();
     t.size();
 };
+
+// The execution_policy concept is satisfied by the standard execution policies, for the overloads which pass one
+// to the standard algorithms.
+
+template<typename P>
+concept execution_policy = std::is_execution_policy_v<std::remove_cvref_t<P>>;
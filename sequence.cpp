@@ -20,6 +20,8 @@ void show(const SEQ& seq)
 		case sequence_storage_lits::FIXED:		std::println("FIXED");		break;
 		case sequence_storage_lits::VARIABLE:	std::println("VARIABLE");	break;
 		case sequence_storage_lits::BUFFERED:	std::println("BUFFERED");	break;
+		case sequence_storage_lits::RESERVED:	std::println("RESERVED");	break;
+		case sequence_storage_lits::SEGMENTED:	std::println("SEGMENTED");	break;
 	}
 	std::print("Location:\t");
 	switch (seq.traits.location)
@@ -27,6 +29,7 @@ void show(const SEQ& seq)
 		case sequence_location_lits::FRONT:		std::println("FRONT");		break;
 		case sequence_location_lits::MIDDLE:	std::println("MIDDLE");		break;
 		case sequence_location_lits::BACK:		std::println("BACK");		break;
+		case sequence_location_lits::CIRCULAR:	std::println("CIRCULAR");	break;
 	}
 	std::print("Growth:\t\t");
 	switch (seq.traits.growth)
@@ -34,6 +37,8 @@ void show(const SEQ& seq)
 		case sequence_growth_lits::LINEAR:		std::println("LINEAR");			break;
 		case sequence_growth_lits::EXPONENTIAL:	std::println("EXPONENTIAL");	break;
 		case sequence_growth_lits::VECTOR:		std::println("VECTOR");			break;
+		case sequence_growth_lits::LEARNED:		std::println("LEARNED");		break;
+		case sequence_growth_lits::CUSTOM:		std::println("CUSTOM");			break;
 	}
 
 	std::println("Capacity:\t{}", seq.traits.capacity);
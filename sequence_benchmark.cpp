@@ -0,0 +1,338 @@
+/*	sequence_benchmark.cpp
+*
+*	Benchmark suite for sequence. Every storage and location (and every growth mode for the storages
+*	which grow) is measured against std::vector, std::deque, boost::small_vector and std::inplace_vector
+*	(or boost::static_vector where std::inplace_vector is not yet available).
+*
+*	Requires Google Benchmark and Boost.Container (see vcpkg.json).
+*/
+
+#include <benchmark/benchmark.h>
+#include <boost/container/small_vector.hpp>
+#include <boost/container/static_vector.hpp>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#if __has_include(<inplace_vector>)
+#include <inplace_vector>
+#endif
+
+import sequence;
+
+// ==============================================================================================================
+// Benchmark parameters.
+
+// The largest container size measured. The fixed capacity of the STATIC and FIXED sequences (and the in-place
+// baseline) is this size, so that all the containers can hold every size measured.
+
+constexpr size_t MAX_SIZE = 4096;
+
+// The buffer size for BUFFERED sequences and boost::small_vector, and the initial capacity for VARIABLE sequences.
+
+constexpr size_t BUFFER_SIZE = 16;
+
+// ==============================================================================================================
+// Element types.
+
+// pod64 - A 64 byte trivially copyable element.
+
+struct pod64
+{
+	std::array<long long, 8> values;
+};
+
+// The make function creates the i'th element value. Strings are long enough to defeat the small string
+// optimization, so that they own an allocation.
+
+template<typename E> E make(size_t i);
+template<> int make<int>(size_t i) { return static_cast<int>(i); }
+template<> pod64 make<pod64>(size_t i) { return {{static_cast<long long>(i)}}; }
+template<> std::string make<std::string>(size_t i) { return std::string(32, 'a' + char(i % 26)); }
+
+// The weight function reduces an element to a number for the iteration benchmark.
+
+size_t weight(int e) { return e; }
+size_t weight(const pod64& e) { return e.values[0]; }
+size_t weight(const std::string& e) { return e.size(); }
+
+// ==============================================================================================================
+// Container adaptors. Not every container supports every operation directly. Elements are emplaced so that
+// every container moves them in.
+
+template<typename C>
+void add_front(C& c, typename C::value_type&& e)
+{
+	if constexpr (requires { c.emplace_front(std::move(e)); })
+		c.emplace_front(std::move(e));
+	else
+		c.emplace(c.begin(), std::move(e));
+}
+
+template<typename C>
+C filled(size_t n)
+{
+	C c;
+	for (size_t i = 0; i < n; ++i)
+		c.emplace_back(make<typename C::value_type>(i));
+	return c;
+}
+
+// ==============================================================================================================
+// Benchmarks. Each one takes the container size as its argument.
+
+template<typename C>
+void push_back(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		C c;
+		for (size_t i = 0; i < n; ++i)
+			c.emplace_back(make<typename C::value_type>(i));
+		benchmark::DoNotOptimize(&c.front());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void push_front(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		C c;
+		for (size_t i = 0; i < n; ++i)
+			add_front(c, make<typename C::value_type>(i));
+		benchmark::DoNotOptimize(&c.front());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void insert_middle(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		C c;
+		for (size_t i = 0; i < n; ++i)
+			c.emplace(c.begin() + c.size() / 2, make<typename C::value_type>(i));
+		benchmark::DoNotOptimize(&c.front());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void erase_middle(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		auto c = filled<C>(n);
+		state.ResumeTiming();
+		while (!c.empty())
+			c.erase(c.begin() + c.size() / 2);
+		benchmark::DoNotOptimize(c.size());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void iterate(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	auto c = filled<C>(n);
+	for (auto _ : state)
+	{
+		size_t sum = 0;
+		for (const auto& e : c)
+			sum += weight(e);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void copy(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	auto c = filled<C>(n);
+	for (auto _ : state)
+	{
+		C d(c);
+		benchmark::DoNotOptimize(&d.front());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<typename C>
+void move(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	auto c = filled<C>(n);
+	for (auto _ : state)
+	{
+		C d(std::move(c));
+		c = std::move(d);
+		benchmark::DoNotOptimize(&c.front());
+	}
+}
+
+template<typename C>
+void swap(benchmark::State& state)
+{
+	auto n = static_cast<size_t>(state.range(0));
+	auto c = filled<C>(n);
+	auto d = filled<C>(n / 2);
+	for (auto _ : state)
+	{
+		c.swap(d);
+		benchmark::DoNotOptimize(&c.front());
+	}
+}
+
+// ==============================================================================================================
+// Registration.
+
+// The register_container function registers every benchmark for one container type. The name identifies the
+// container and element types. The middle insertion and erasure benchmarks are quadratic, so their maximum
+// size is smaller.
+
+template<typename C>
+void register_container(const std::string& name)
+{
+	auto add = [&name](const char* op, void (*bench)(benchmark::State&), size_t max_size)
+	{
+		benchmark::RegisterBenchmark((name + "/" + op).c_str(), bench)->RangeMultiplier(8)->Range(8, max_size);
+	};
+
+	add("push_back", push_back<C>, MAX_SIZE);
+	add("push_front", push_front<C>, MAX_SIZE);
+	add("insert_middle", insert_middle<C>, MAX_SIZE / 8);
+	add("erase_middle", erase_middle<C>, MAX_SIZE / 8);
+	add("iterate", iterate<C>, MAX_SIZE);
+	add("copy", copy<C>, MAX_SIZE);
+	add("move", move<C>, MAX_SIZE);
+	add("swap", swap<C>, MAX_SIZE);
+}
+
+constexpr const char* storage_name(sequence_storage_lits storage)
+{
+	switch (storage)
+	{
+		case sequence_storage_lits::STATIC:		return "STATIC";
+		case sequence_storage_lits::FIXED:		return "FIXED";
+		case sequence_storage_lits::VARIABLE:	return "VARIABLE";
+		case sequence_storage_lits::BUFFERED:	return "BUFFERED";
+		case sequence_storage_lits::RESERVED:	return "RESERVED";
+		case sequence_storage_lits::SEGMENTED:	return "SEGMENTED";
+	}
+	return "";
+}
+constexpr const char* location_name(sequence_location_lits location)
+{
+	switch (location)
+	{
+		case sequence_location_lits::FRONT:		return "FRONT";
+		case sequence_location_lits::BACK:		return "BACK";
+		case sequence_location_lits::MIDDLE:	return "MIDDLE";
+		case sequence_location_lits::CIRCULAR:	return "CIRCULAR";
+	}
+	return "";
+}
+constexpr const char* growth_name(sequence_growth_lits growth)
+{
+	switch (growth)
+	{
+		case sequence_growth_lits::LINEAR:		return "LINEAR";
+		case sequence_growth_lits::EXPONENTIAL:	return "EXPONENTIAL";
+		case sequence_growth_lits::VECTOR:		return "VECTOR";
+		case sequence_growth_lits::LEARNED:		return "LEARNED";
+		case sequence_growth_lits::CUSTOM:		return "CUSTOM";
+	}
+	return "";
+}
+
+// The register_sequence function registers the benchmarks for one traits combination. The fixed storages
+// do not grow, so they are registered only once (with the default growth mode). LINEAR growth uses an
+// increment of BUFFER_SIZE. LEARNED growth learns from all the sequences of its traits destroyed so far (in any
+// of their benchmarks). CUSTOM growth doubles the capacity. RESERVED storage reserves several times the largest
+// size measured, so that MIDDLE location sequences do not reach the ends of the reservation. SEGMENTED storage
+// uses chunks of BUFFER_SIZE elements.
+
+template<typename E, sequence_storage_lits STO, sequence_location_lits LOC, sequence_growth_lits GROW>
+void register_sequence(const std::string& element_name)
+{
+	constexpr bool fixed = STO == sequence_storage_lits::STATIC || STO == sequence_storage_lits::FIXED;
+	if constexpr (!fixed || GROW == sequence_growth_lits::VECTOR)
+	{
+		constexpr sequence_traits<size_t> traits{.storage = STO, .location = LOC, .growth = GROW,
+												 .capacity = fixed ? MAX_SIZE : BUFFER_SIZE, .reservation = 4 * MAX_SIZE,
+												 .increment = BUFFER_SIZE,
+												 .growth_function = GROW == sequence_growth_lits::CUSTOM ?
+													+[](size_t cap) { return 2 * cap; } : nullptr};
+		std::string name = std::string("sequence<") + storage_name(STO) + "," + location_name(LOC);
+		if constexpr (!fixed)
+			name += std::string(",") + growth_name(GROW);
+		register_container<sequence<E, traits>>(name + ">/" + element_name);
+	}
+}
+
+template<typename E, sequence_storage_lits STO, sequence_location_lits LOC>
+void register_growths(const std::string& element_name)
+{
+	register_sequence<E, STO, LOC, sequence_growth_lits::LINEAR>(element_name);
+	register_sequence<E, STO, LOC, sequence_growth_lits::EXPONENTIAL>(element_name);
+	register_sequence<E, STO, LOC, sequence_growth_lits::VECTOR>(element_name);
+	register_sequence<E, STO, LOC, sequence_growth_lits::LEARNED>(element_name);
+	register_sequence<E, STO, LOC, sequence_growth_lits::CUSTOM>(element_name);
+}
+
+template<typename E, sequence_storage_lits STO>
+void register_locations(const std::string& element_name)
+{
+	register_growths<E, STO, sequence_location_lits::FRONT>(element_name);
+	register_growths<E, STO, sequence_location_lits::BACK>(element_name);
+	register_growths<E, STO, sequence_location_lits::MIDDLE>(element_name);
+	if constexpr (STO == sequence_storage_lits::STATIC || STO == sequence_storage_lits::FIXED)
+		register_growths<E, STO, sequence_location_lits::CIRCULAR>(element_name);
+}
+
+template<typename E>
+void register_element(const std::string& element_name)
+{
+	register_container<std::vector<E>>("std::vector/" + element_name);
+	register_container<std::deque<E>>("std::deque/" + element_name);
+	register_container<boost::container::small_vector<E, BUFFER_SIZE>>("boost::small_vector/" + element_name);
+#if __cpp_lib_inplace_vector
+	register_container<std::inplace_vector<E, MAX_SIZE>>("std::inplace_vector/" + element_name);
+#else
+	register_container<boost::container::static_vector<E, MAX_SIZE>>("boost::static_vector/" + element_name);
+#endif
+
+	register_locations<E, sequence_storage_lits::STATIC>(element_name);
+	register_locations<E, sequence_storage_lits::FIXED>(element_name);
+	register_locations<E, sequence_storage_lits::VARIABLE>(element_name);
+	register_locations<E, sequence_storage_lits::BUFFERED>(element_name);
+	register_locations<E, sequence_storage_lits::RESERVED>(element_name);
+	register_locations<E, sequence_storage_lits::SEGMENTED>(element_name);
+}
+
+int main(int argc, char** argv)
+{
+	register_element<int>("int");
+	register_element<pod64>("pod64");
+	register_element<std::string>("string");
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}